@@ -0,0 +1,45 @@
+#include "pch.h"
+#include "AssetLoader.h"
+#include "Mesh.h"
+
+namespace dae
+{
+	AssetLoader::AssetLoader(ID3D11Device* pDevice)
+		: m_pDevice(pDevice)
+	{
+	}
+
+	AssetLoader::~AssetLoader()
+	{
+		for (const auto& pLoad : m_pLoads)
+		{
+			JobSystem::Get().Wait(*pLoad);
+		}
+	}
+
+	AssetFuture<Texture*> AssetLoader::LoadTexture(const std::string& path, TextureFormat cpuFormat)
+	{
+		// decoding, encoding & uploading, the device is free threaded.
+		// the id is taken here, in call order, not in whichever order the jobs get to it
+		const uint32_t id = Texture::ReserveId();
+		return Start<Texture*>([pDevice = m_pDevice, path, cpuFormat, id]() { return Texture::LoadFromFile(pDevice, path, cpuFormat, id); });
+	}
+
+	AssetFuture<Mesh*> AssetLoader::LoadMesh(BaseEffect* pEffect, const std::string& path)
+	{
+		return Start<Mesh*>([pDevice = m_pDevice, pEffect, path]() { return new Mesh(pDevice, pEffect, path); });
+	}
+
+	template<typename T, typename Load>
+	AssetFuture<T> AssetLoader::Start(Load load)
+	{
+		AssetFuture<T> future{};
+		future.m_pState = std::make_shared<typename AssetFuture<T>::State>();
+
+		// shares ownership of the state, the counter stays alive even if the future gets dropped
+		m_pLoads.emplace_back(future.m_pState, &future.m_pState->counter);
+
+		JobSystem::Get().Run([pState = future.m_pState, load]() { pState->value = load(); }, &future.m_pState->counter);
+		return future;
+	}
+}
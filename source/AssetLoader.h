@@ -0,0 +1,67 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "JobSystem.h"
+#include "Texture.h"
+
+class Mesh;
+class BaseEffect;
+
+namespace dae
+{
+	// result of a load running on the job system. Get joins it: the caller runs other jobs until the load finished,
+	// so it's fine to call from anywhere, workers included
+	template<typename T>
+	class AssetFuture final
+	{
+	public:
+		AssetFuture() = default;
+
+		bool IsValid() const { return m_pState != nullptr; };
+		bool IsReady() const { return m_pState->counter.IsDone(); };
+
+		T Get() const
+		{
+			JobSystem::Get().Wait(m_pState->counter);
+			return m_pState->value;
+		};
+
+	private:
+		friend class AssetLoader;
+
+		struct State
+		{
+			JobSystem::Counter counter;
+			T value{};
+		};
+
+		std::shared_ptr<State> m_pState;
+	};
+
+	// starts decoding & parsing as soon as an asset is asked for, so every file loads at the same time.
+	// whoever joins a future owns what it returns
+	class AssetLoader final
+	{
+	public:
+		explicit AssetLoader(ID3D11Device* pDevice);
+		// waits for loads nobody joined, they still use the device
+		~AssetLoader();
+
+		AssetLoader(const AssetLoader&) = delete;
+		AssetLoader(AssetLoader&&) noexcept = delete;
+		AssetLoader& operator=(const AssetLoader&) = delete;
+		AssetLoader& operator=(AssetLoader&&) noexcept = delete;
+
+		AssetFuture<Texture*> LoadTexture(const std::string& path, TextureFormat cpuFormat = TextureFormat::RGBA8);
+		// parses, simplifies & clusters the obj on a worker, the effect only gets used once the mesh renders
+		AssetFuture<Mesh*> LoadMesh(BaseEffect* pEffect, const std::string& path);
+
+	private:
+		ID3D11Device* m_pDevice;
+		std::vector<std::shared_ptr<const JobSystem::Counter>> m_pLoads;
+
+		template<typename T, typename Load>
+		AssetFuture<T> Start(Load load);
+	};
+}
@@ -1,8 +1,8 @@
 #include "pch.h"
 #include "BaseEffect.h"
 
-BaseEffect::BaseEffect(ID3D11Device* pDevice, const std::wstring& assetFile)
-	: m_pEffect(), m_pTechnique()
+BaseEffect::BaseEffect(ID3D11Device* pDevice, const std::wstring& assetFile, AssetFuture<Texture*> diffuseLoad)
+	: m_pEffect(), m_pTechnique(), m_DiffuseLoad(diffuseLoad)
 {
 	HRESULT result = S_OK;
 	ID3D10Blob* pErrorBlob = nullptr;
@@ -70,6 +70,9 @@ BaseEffect::BaseEffect(ID3D11Device* pDevice, const std::wstring& assetFile)
 
 BaseEffect::~BaseEffect()
 {
+	// owns the texture even if nothing ever asked for it
+	BaseEffect::FinishLoading();
+
 	m_pDiffuseMap->Release();
 	m_pMatWorldViewProj->Release();
 	m_pTechnique->Release();
@@ -101,6 +104,18 @@ void BaseEffect::SetDiffuseMap(Texture* pDiffuseMap)
 	}
 }
 
+void BaseEffect::FinishLoading()
+{
+	if (m_IsLoaded)
+	{
+		return;
+	}
+
+	m_pTexture = m_DiffuseLoad.Get();
+	SetDiffuseMap(m_pTexture);
+	m_IsLoaded = true;
+}
+
 void BaseEffect::SetRasterizer(ID3D11RasterizerState* rasterizer)
 {
 	HRESULT hr = m_pRasterizerState->SetRasterizerState(0, rasterizer);
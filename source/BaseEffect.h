@@ -1,12 +1,19 @@
 #pragma once
 #include "Texture.h"
+#include "AssetLoader.h"
+
+namespace dae
+{
+	enum class ShaderProgram;
+}
 
 using namespace dae;
 
 class BaseEffect
 {
 public:
-	BaseEffect(ID3D11Device* pDevice, const std::wstring& assetFile);
+	// diffuseLoad gets joined by FinishLoading
+	BaseEffect(ID3D11Device* pDevice, const std::wstring& assetFile, AssetFuture<Texture*> diffuseLoad);
 	virtual ~BaseEffect();
 	ID3DX11Effect* GetEffect();
 	ID3DX11EffectTechnique* GetTechnique();
@@ -21,16 +28,24 @@ public:
 	virtual Texture* GetSpecular() { return nullptr; };
 
 	virtual ID3D11InputLayout* CreateInputLayout(ID3D11Device* pDevice) = 0;
+	// the software renderer's counterpart of this effect
+	virtual ShaderProgram GetSoftwareShader() const = 0;
 	void SetDiffuseMap(Texture* pDiffuseMap);
 	void SetRasterizer(ID3D11RasterizerState* rasterizer);
 
+	// waits for the textures handed to the constructor & binds them, the texture getters call it too.
+	// main thread only, effect variables aren't thread safe
+	virtual void FinishLoading();
+
 protected:
 	ID3DX11Effect* m_pEffect;
 	ID3DX11EffectTechnique* m_pTechnique;
 	ID3DX11EffectShaderResourceVariable* m_pDiffuseMap;
 	ID3DX11EffectRasterizerVariable* m_pRasterizerState;
 
-	Texture* m_pTexture;
+	Texture* m_pTexture{};
+	AssetFuture<Texture*> m_DiffuseLoad;
+	bool m_IsLoaded = false;
 
 	ID3DX11EffectMatrixVariable* m_pMatWorldViewProj;
 };
@@ -0,0 +1,348 @@
+#include "pch.h"
+#include "BlockCompression.h"
+#include <cstring>
+
+namespace dae
+{
+	namespace BlockCompression
+	{
+		namespace
+		{
+			uint8_t Channel(uint32_t texel, int channel)
+			{
+				return static_cast<uint8_t>(texel >> (channel * 8));
+			}
+
+			uint32_t Pack(int r, int g, int b, int a)
+			{
+				return static_cast<uint32_t>(r) | static_cast<uint32_t>(g) << 8 | static_cast<uint32_t>(b) << 16 | static_cast<uint32_t>(a) << 24;
+			}
+
+			uint16_t To565(int r, int g, int b)
+			{
+				return static_cast<uint16_t>((r >> 3) << 11 | (g >> 2) << 5 | (b >> 3));
+			}
+
+			void From565(uint16_t color, int* pRgb)
+			{
+				const int r = (color >> 11) & 31;
+				const int g = (color >> 5) & 63;
+				const int b = color & 31;
+
+				pRgb[0] = (r << 3) | (r >> 2);
+				pRgb[1] = (g << 2) | (g >> 4);
+				pRgb[2] = (b << 3) | (b >> 2);
+			}
+
+			// 2 endpoints & 2 bit indices, always in 4 color mode (color0 > color1) unless the endpoints are equal
+			void EncodeColor(const uint32_t* pTexels, uint8_t* pBlock)
+			{
+				int minColor[3]{ 255, 255, 255 };
+				int maxColor[3]{ 0, 0, 0 };
+
+				for (int i = 0; i < BlockTexels; ++i)
+				{
+					for (int c = 0; c < 3; ++c)
+					{
+						minColor[c] = std::min(minColor[c], int(Channel(pTexels[i], c)));
+						maxColor[c] = std::max(maxColor[c], int(Channel(pTexels[i], c)));
+					}
+				}
+
+				// pulling the endpoints in a 16th of the range lowers the error of the texels in between
+				for (int c = 0; c < 3; ++c)
+				{
+					const int inset = (maxColor[c] - minColor[c]) >> 4;
+					minColor[c] += inset;
+					maxColor[c] -= inset;
+				}
+
+				// the box has 4 diagonals, flip the channels that go down while the widest one goes up
+				int widest{};
+
+				for (int c = 1; c < 3; ++c)
+				{
+					if (maxColor[c] - minColor[c] > maxColor[widest] - minColor[widest])
+					{
+						widest = c;
+					}
+				}
+
+				int mean[3]{};
+
+				for (int i = 0; i < BlockTexels; ++i)
+				{
+					for (int c = 0; c < 3; ++c)
+					{
+						mean[c] += Channel(pTexels[i], c);
+					}
+				}
+
+				for (int c = 0; c < 3; ++c)
+				{
+					int covariance{};
+
+					for (int i = 0; i < BlockTexels; ++i)
+					{
+						covariance += (Channel(pTexels[i], widest) * BlockTexels - mean[widest]) * (Channel(pTexels[i], c) * BlockTexels - mean[c]);
+					}
+
+					if (covariance < 0)
+					{
+						std::swap(minColor[c], maxColor[c]);
+					}
+				}
+
+				uint16_t color0 = To565(maxColor[0], maxColor[1], maxColor[2]);
+				uint16_t color1 = To565(minColor[0], minColor[1], minColor[2]);
+
+				if (color0 < color1)
+				{
+					std::swap(color0, color1);
+				}
+
+				int palette[4][3]{};
+				From565(color0, palette[0]);
+				From565(color1, palette[1]);
+
+				for (int c = 0; c < 3; ++c)
+				{
+					palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+					palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+				}
+
+				uint32_t indices{};
+
+				if (color0 != color1)
+				{
+					for (int i = 0; i < BlockTexels; ++i)
+					{
+						int bestIndex{};
+						int bestDistance{ INT_MAX };
+
+						for (int p = 0; p < 4; ++p)
+						{
+							int distance{};
+
+							for (int c = 0; c < 3; ++c)
+							{
+								const int delta = int(Channel(pTexels[i], c)) - palette[p][c];
+								distance += delta * delta;
+							}
+
+							if (distance < bestDistance)
+							{
+								bestDistance = distance;
+								bestIndex = p;
+							}
+						}
+
+						indices |= static_cast<uint32_t>(bestIndex) << (i * 2);
+					}
+				}
+
+				std::memcpy(pBlock, &color0, 2);
+				std::memcpy(pBlock + 2, &color1, 2);
+				std::memcpy(pBlock + 4, &indices, 4);
+			}
+
+			void DecodeColor(const uint8_t* pBlock, bool allowTransparent, uint32_t* pTexels)
+			{
+				uint16_t color0{};
+				uint16_t color1{};
+				uint32_t indices{};
+				std::memcpy(&color0, pBlock, 2);
+				std::memcpy(&color1, pBlock + 2, 2);
+				std::memcpy(&indices, pBlock + 4, 4);
+
+				int rgb0[3]{};
+				int rgb1[3]{};
+				From565(color0, rgb0);
+				From565(color1, rgb1);
+
+				uint32_t palette[4]{};
+				palette[0] = Pack(rgb0[0], rgb0[1], rgb0[2], 255);
+				palette[1] = Pack(rgb1[0], rgb1[1], rgb1[2], 255);
+
+				if (color0 > color1 || !allowTransparent)
+				{
+					palette[2] = Pack((2 * rgb0[0] + rgb1[0] + 1) / 3, (2 * rgb0[1] + rgb1[1] + 1) / 3, (2 * rgb0[2] + rgb1[2] + 1) / 3, 255);
+					palette[3] = Pack((rgb0[0] + 2 * rgb1[0] + 1) / 3, (rgb0[1] + 2 * rgb1[1] + 1) / 3, (rgb0[2] + 2 * rgb1[2] + 1) / 3, 255);
+				}
+				else
+				{
+					palette[2] = Pack((rgb0[0] + rgb1[0]) / 2, (rgb0[1] + rgb1[1]) / 2, (rgb0[2] + rgb1[2]) / 2, 255);
+					palette[3] = 0;
+				}
+
+				for (int i = 0; i < BlockTexels; ++i)
+				{
+					pTexels[i] = palette[(indices >> (i * 2)) & 3];
+				}
+			}
+
+			// 2 endpoints & 3 bit indices, always in 8 value mode (value0 > value1) unless the endpoints are equal
+			void EncodeChannel(const uint32_t* pTexels, int channel, uint8_t* pBlock)
+			{
+				int minValue{ 255 };
+				int maxValue{ 0 };
+
+				for (int i = 0; i < BlockTexels; ++i)
+				{
+					minValue = std::min(minValue, int(Channel(pTexels[i], channel)));
+					maxValue = std::max(maxValue, int(Channel(pTexels[i], channel)));
+				}
+
+				uint64_t indices{};
+
+				if (maxValue != minValue)
+				{
+					// palette order: max, min, then 6 steps from max to min
+					static constexpr int PaletteOrder[8]{ 0, 2, 3, 4, 5, 6, 7, 1 };
+					const int range = maxValue - minValue;
+
+					for (int i = 0; i < BlockTexels; ++i)
+					{
+						// 0 = max ... 7 = min, rounded to the closest step
+						const int step = ((maxValue - int(Channel(pTexels[i], channel))) * 14 + range) / (2 * range);
+						indices |= static_cast<uint64_t>(PaletteOrder[step]) << (i * 3);
+					}
+				}
+
+				pBlock[0] = static_cast<uint8_t>(maxValue);
+				pBlock[1] = static_cast<uint8_t>(minValue);
+
+				for (int b = 0; b < 6; ++b)
+				{
+					pBlock[2 + b] = static_cast<uint8_t>(indices >> (b * 8));
+				}
+			}
+
+			void DecodeChannel(const uint8_t* pBlock, uint8_t* pValues)
+			{
+				const int value0 = pBlock[0];
+				const int value1 = pBlock[1];
+
+				uint8_t palette[8]{};
+				palette[0] = static_cast<uint8_t>(value0);
+				palette[1] = static_cast<uint8_t>(value1);
+
+				if (value0 > value1)
+				{
+					for (int i = 1; i < 7; ++i)
+					{
+						palette[i + 1] = static_cast<uint8_t>(((7 - i) * value0 + i * value1 + 3) / 7);
+					}
+				}
+				else
+				{
+					for (int i = 1; i < 5; ++i)
+					{
+						palette[i + 1] = static_cast<uint8_t>(((5 - i) * value0 + i * value1 + 2) / 5);
+					}
+
+					palette[6] = 0;
+					palette[7] = 255;
+				}
+
+				uint64_t indices{};
+
+				for (int b = 0; b < 6; ++b)
+				{
+					indices |= static_cast<uint64_t>(pBlock[2 + b]) << (b * 8);
+				}
+
+				for (int i = 0; i < BlockTexels; ++i)
+				{
+					pValues[i] = palette[(indices >> (i * 3)) & 7];
+				}
+			}
+		}
+
+		int GetBlockSize(TextureFormat format)
+		{
+			switch (format)
+			{
+			case TextureFormat::BC1:
+			case TextureFormat::BC4:
+				return 8;
+			case TextureFormat::BC3:
+			case TextureFormat::BC5:
+				return 16;
+			default:
+				return 0;
+			}
+		}
+
+		void EncodeBlock(TextureFormat format, const uint32_t* pTexels, uint8_t* pBlock)
+		{
+			switch (format)
+			{
+			case TextureFormat::BC1:
+				EncodeColor(pTexels, pBlock);
+				break;
+			case TextureFormat::BC3:
+				EncodeChannel(pTexels, 3, pBlock);
+				EncodeColor(pTexels, pBlock + 8);
+				break;
+			case TextureFormat::BC4:
+				EncodeChannel(pTexels, 0, pBlock);
+				break;
+			case TextureFormat::BC5:
+				EncodeChannel(pTexels, 0, pBlock);
+				EncodeChannel(pTexels, 1, pBlock + 8);
+				break;
+			default:
+				break;
+			}
+		}
+
+		void DecodeBlock(TextureFormat format, const uint8_t* pBlock, uint32_t* pTexels)
+		{
+			uint8_t values[BlockTexels]{};
+
+			switch (format)
+			{
+			case TextureFormat::BC1:
+				DecodeColor(pBlock, true, pTexels);
+				break;
+			case TextureFormat::BC3:
+				DecodeColor(pBlock + 8, false, pTexels);
+				DecodeChannel(pBlock, values);
+
+				for (int i = 0; i < BlockTexels; ++i)
+				{
+					pTexels[i] = (pTexels[i] & 0x00FFFFFF) | static_cast<uint32_t>(values[i]) << 24;
+				}
+				break;
+			case TextureFormat::BC4:
+				DecodeChannel(pBlock, values);
+
+				for (int i = 0; i < BlockTexels; ++i)
+				{
+					pTexels[i] = Pack(values[i], values[i], values[i], 255);
+				}
+				break;
+			case TextureFormat::BC5:
+			{
+				uint8_t valuesY[BlockTexels]{};
+				DecodeChannel(pBlock, values);
+				DecodeChannel(pBlock + 8, valuesY);
+
+				for (int i = 0; i < BlockTexels; ++i)
+				{
+					// unit length normal, z always faces out of the surface
+					const float x = values[i] / 127.5f - 1.f;
+					const float y = valuesY[i] / 127.5f - 1.f;
+					const float z = std::sqrt(std::max(0.f, 1.f - x * x - y * y));
+
+					pTexels[i] = Pack(values[i], valuesY[i], static_cast<int>((z * 0.5f + 0.5f) * 255.f + 0.5f), 255);
+				}
+				break;
+			}
+			default:
+				break;
+			}
+		}
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+
+namespace dae
+{
+	// how the cpu side copy of a texture is stored. the BC formats keep 4 x 4 texels per block:
+	// BC1 rgb in 8 bytes, BC3 rgba in 16, BC4 one channel in 8 & BC5 two channels in 16.
+	// decoded texels are packed r | g << 8 | b << 16 | a << 24
+	enum class TextureFormat
+	{
+		RGBA8 = 0,
+		BC1 = 1,
+		BC3 = 2,
+		BC4 = 3,
+		BC5 = 4
+	};
+
+	namespace BlockCompression
+	{
+		constexpr int BlockDimension = 4;
+		constexpr int BlockTexels = BlockDimension * BlockDimension;
+
+		// bytes per block, 0 for RGBA8
+		int GetBlockSize(TextureFormat format);
+
+		// bounding box endpoints, every texel takes the closest palette entry. fast enough to run at load
+		void EncodeBlock(TextureFormat format, const uint32_t* pTexels, uint8_t* pBlock);
+		// BC4 fills rgb with its channel, BC5 stores x & y of a normal & rebuilds z into blue
+		void DecodeBlock(TextureFormat format, const uint8_t* pBlock, uint32_t* pTexels);
+	}
+}
@@ -36,10 +36,15 @@ namespace dae
 		Matrix invViewMatrix{};
 		Matrix viewMatrix{};
 		Matrix projectionMatrix{};
+		// near maps to 1 and far to 0, spreads float precision evenly over the depth range
+		Matrix reversedProjectionMatrix{};
 
 		const float camVelocity = 15.0f;
 		float angleVelocity = 3.5f;
 
+		// bumped whenever the view or projection changed, so renderers can tell an idle camera apart
+		uint32_t version{};
+
 		void Initialize(float _aspectRatio = 1.0f, float _fovAngle = 90.f, Vector3 _origin = {0.f,0.f,0.f})
 		{
 			aspectRatio = _aspectRatio;
@@ -48,6 +53,7 @@ namespace dae
 			fov = tanf((fovAngle * TO_RADIANS) / 2.f);
 
 			origin = _origin;
+			++version;
 		}
 
 		void CalculateViewMatrix()
@@ -62,11 +68,14 @@ namespace dae
 		void CalculateProjectionMatrix()
 		{
 			projectionMatrix = Matrix::CreatePerspectiveFovLH(fov, aspectRatio, nearPlane, farPlane);
+			reversedProjectionMatrix = Matrix::CreatePerspectiveFovLH(fov, aspectRatio, farPlane, nearPlane);
 		}
 
 		void Update(const Timer* pTimer)
 		{
 			const float deltaTime = pTimer->GetElapsed();
+			const Vector3 previousOrigin = origin;
+			const Vector3 previousForward = forward;
 
 			// Get current keyboard state
 			const uint8_t* pKeyboardState = SDL_GetKeyboardState(nullptr);
@@ -105,6 +114,12 @@ namespace dae
 			//Update Matrices
 			CalculateViewMatrix();
 			CalculateProjectionMatrix(); //Try to optimize this - should only be called once or when fov/aspectRatio changes
+
+			if (origin.x != previousOrigin.x || origin.y != previousOrigin.y || origin.z != previousOrigin.z ||
+				forward.x != previousForward.x || forward.y != previousForward.y || forward.z != previousForward.z)
+			{
+				++version;
+			}
 		}
 	};
 }
@@ -0,0 +1,97 @@
+#include "pch.h"
+#include "DepthBuffer.h"
+
+namespace dae
+{
+	DepthBuffer::DepthBuffer(int width, int height, Format format)
+		: m_Width(width), m_Height(height)
+	{
+		SetFormat(format);
+	}
+
+	DepthBuffer::~DepthBuffer()
+	{
+		Release();
+	}
+
+	void DepthBuffer::SetFormat(Format format)
+	{
+		Release();
+		m_Format = format;
+
+		const int size = m_Width * m_Height * m_SampleCount;
+
+		switch (m_Format)
+		{
+			case Format::Unorm24:
+				// 24 bits stored in 32, same layout as D24 without the stencil byte
+				m_pUnorm24Pixels = new uint32_t[size];
+				break;
+			case Format::Unorm16:
+				m_pUnorm16Pixels = new uint16_t[size];
+				break;
+			case Format::Float32:
+			case Format::Float32Reversed:
+			default:
+				m_pFloatPixels = new float[size];
+				break;
+		}
+
+		Clear(0, size);
+	}
+
+	void DepthBuffer::Resize(int width, int height, int sampleCount)
+	{
+		m_Width = width;
+		m_Height = height;
+		m_SampleCount = sampleCount;
+		SetFormat(m_Format);
+	}
+
+	void DepthBuffer::Clear(int start, int end)
+	{
+		switch (m_Format)
+		{
+			case Format::Float32Reversed:
+				std::fill(m_pFloatPixels + start, m_pFloatPixels + end, 0.f);
+				break;
+			case Format::Unorm24:
+				std::fill(m_pUnorm24Pixels + start, m_pUnorm24Pixels + end, 0xFFFFFFu);
+				break;
+			case Format::Unorm16:
+				std::fill(m_pUnorm16Pixels + start, m_pUnorm16Pixels + end, uint16_t(0xFFFF));
+				break;
+			case Format::Float32:
+			default:
+				std::fill(m_pFloatPixels + start, m_pFloatPixels + end, 1.f);
+				break;
+		}
+	}
+
+	int DepthBuffer::CountWritten(int start, int end) const
+	{
+		switch (m_Format)
+		{
+			case Format::Float32Reversed:
+				return static_cast<int>(std::count_if(m_pFloatPixels + start, m_pFloatPixels + end, [](float depth) { return depth != 0.f; }));
+			case Format::Unorm24:
+				return static_cast<int>(std::count_if(m_pUnorm24Pixels + start, m_pUnorm24Pixels + end, [](uint32_t depth) { return depth != 0xFFFFFFu; }));
+			case Format::Unorm16:
+				return static_cast<int>(std::count_if(m_pUnorm16Pixels + start, m_pUnorm16Pixels + end, [](uint16_t depth) { return depth != 0xFFFF; }));
+			case Format::Float32:
+			default:
+				return static_cast<int>(std::count_if(m_pFloatPixels + start, m_pFloatPixels + end, [](float depth) { return depth != 1.f; }));
+		}
+	}
+
+	void DepthBuffer::Release()
+	{
+		delete[] m_pFloatPixels;
+		delete[] m_pUnorm24Pixels;
+		delete[] m_pUnorm16Pixels;
+
+		m_pFloatPixels = nullptr;
+		m_pUnorm24Pixels = nullptr;
+		m_pUnorm16Pixels = nullptr;
+	}
+}
@@ -0,0 +1,121 @@
+#pragma once
+#include <cstdint>
+
+namespace dae
+{
+	class DepthBuffer final
+	{
+	public:
+		enum class Format
+		{
+			Float32,
+			Float32Reversed,
+			Unorm24,
+			Unorm16,
+			End
+		};
+
+		DepthBuffer(int width, int height, Format format = Format::Float32);
+		~DepthBuffer();
+
+		DepthBuffer(const DepthBuffer&) = delete;
+		DepthBuffer(DepthBuffer&&) noexcept = delete;
+		DepthBuffer& operator=(const DepthBuffer&) = delete;
+		DepthBuffer& operator=(DepthBuffer&&) noexcept = delete;
+
+		void SetFormat(Format format);
+		// reallocates & clears, the old contents are lost.
+		// with multiple samples, the samples of a pixel are stored next to each other (pixel * sampleCount + sample)
+		void Resize(int width, int height, int sampleCount = 1);
+		Format GetFormat() const { return m_Format; };
+		bool IsReversed() const { return m_Format == Format::Float32Reversed; };
+
+		// clears pixels [start, end)
+		void Clear(int start, int end);
+		// pixels in [start, end) that got written since they were cleared
+		int CountWritten(int start, int end) const;
+
+		// depth test against the stored value, writes the new depth when it passes
+		bool TestAndWrite(int index, float depth)
+		{
+			switch (m_Format)
+			{
+				case Format::Float32Reversed:
+				{
+					if (depth < m_pFloatPixels[index])
+					{
+						return false;
+					}
+
+					m_pFloatPixels[index] = depth;
+					return true;
+				}
+				case Format::Unorm24:
+				{
+					const uint32_t encoded = static_cast<uint32_t>(depth * 16777215.f + 0.5f);
+
+					if (encoded > m_pUnorm24Pixels[index])
+					{
+						return false;
+					}
+
+					m_pUnorm24Pixels[index] = encoded;
+					return true;
+				}
+				case Format::Unorm16:
+				{
+					const uint16_t encoded = static_cast<uint16_t>(depth * 65535.f + 0.5f);
+
+					if (encoded > m_pUnorm16Pixels[index])
+					{
+						return false;
+					}
+
+					m_pUnorm16Pixels[index] = encoded;
+					return true;
+				}
+				case Format::Float32:
+				default:
+				{
+					if (depth > m_pFloatPixels[index])
+					{
+						return false;
+					}
+
+					m_pFloatPixels[index] = depth;
+					return true;
+				}
+			}
+		};
+
+		// same test as TestAndWrite, the stored depth stays untouched
+		bool Test(int index, float depth) const
+		{
+			switch (m_Format)
+			{
+				case Format::Float32Reversed:
+					return depth >= m_pFloatPixels[index];
+				case Format::Unorm24:
+					return static_cast<uint32_t>(depth * 16777215.f + 0.5f) <= m_pUnorm24Pixels[index];
+				case Format::Unorm16:
+					return static_cast<uint16_t>(depth * 65535.f + 0.5f) <= m_pUnorm16Pixels[index];
+				case Format::Float32:
+				default:
+					return depth <= m_pFloatPixels[index];
+			}
+		};
+
+	private:
+		int m_Width{};
+		int m_Height{};
+		int m_SampleCount{ 1 };
+		Format m_Format{ Format::Float32 };
+
+		// only the buffer matching the current format is allocated
+		float* m_pFloatPixels{ nullptr };
+		uint32_t* m_pUnorm24Pixels{ nullptr };
+		uint16_t* m_pUnorm16Pixels{ nullptr };
+
+		void Release();
+	};
+}
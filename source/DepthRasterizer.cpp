@@ -0,0 +1,135 @@
+#include "pch.h"
+#include "DepthRasterizer.h"
+
+#include <emmintrin.h>
+
+namespace dae
+{
+	void DepthRasterizer::SetTarget(float* pDepth, int width, int height, int pitch, bool isReversed, bool isReciprocal)
+	{
+		m_pDepth = pDepth;
+		m_Width = width;
+		m_Height = height;
+		m_Pitch = pitch;
+		m_IsReversed = isReversed;
+		m_IsReciprocal = isReciprocal;
+	}
+
+	bool DepthRasterizer::TriangleSetup::Initialize(const Vector3& v0, const Vector3& v1, const Vector3& v2, bool reciprocal)
+	{
+		// signed, dividing the edge functions by it makes both windings come out positive inside
+		const float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+
+		if (area == 0.f)
+		{
+			return false;
+		}
+
+		// barycentric weight of each vertex as a plane a * x + b * y + c, 0 on the opposite edge.
+		// x & y are relative to v0, which keeps the planes precise for small triangles far from the origin
+		const float invArea = 1.f / area;
+		a1 = (v2.y - v0.y) * invArea;
+		b1 = (v0.x - v2.x) * invArea;
+		a2 = (v0.y - v1.y) * invArea;
+		b2 = (v1.x - v0.x) * invArea;
+		a0 = -(a1 + a2);
+		b0 = -(b1 + b2);
+
+		// depth (or its reciprocal) is the weighted sum of the vertex depths, so a plane as well
+		const float z0 = reciprocal ? 1.f / v0.z : v0.z;
+		const float z1 = reciprocal ? 1.f / v1.z : v1.z;
+		const float z2 = reciprocal ? 1.f / v2.z : v2.z;
+
+		az = a1 * (z1 - z0) + a2 * (z2 - z0);
+		bz = b1 * (z1 - z0) + b2 * (z2 - z0);
+		cz = z0;
+
+		x0 = v0.x;
+		y0 = v0.y;
+		isReciprocal = reciprocal;
+		return true;
+	}
+
+	void DepthRasterizer::RasterizeTriangle(const Vector3& v0, const Vector3& v1, const Vector3& v2, int left, int top, int right, int bottom) const
+	{
+		TriangleSetup setup{};
+
+		if (!setup.Initialize(v0, v1, v2, m_IsReciprocal))
+		{
+			return;
+		}
+
+		const int minX = std::max({ left, 0, static_cast<int>(ceilf(std::min({ v0.x, v1.x, v2.x }))) });
+		const int maxX = std::min({ right, m_Width, static_cast<int>(floorf(std::max({ v0.x, v1.x, v2.x }))) + 1 });
+		const int minY = std::max({ top, 0, static_cast<int>(ceilf(std::min({ v0.y, v1.y, v2.y }))) });
+		const int maxY = std::min({ bottom, m_Height, static_cast<int>(floorf(std::max({ v0.y, v1.y, v2.y }))) + 1 });
+
+		if (minX >= maxX || minY >= maxY)
+		{
+			return;
+		}
+
+		// every operation in the same order as TriangleSetup::Evaluate, so the results match it exactly
+		const __m128 columnOffsets = _mm_setr_ps(0.f, 1.f, 2.f, 3.f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.f);
+		const __m128 x0s = _mm_set1_ps(setup.x0);
+		const __m128 a0s = _mm_set1_ps(setup.a0), a1s = _mm_set1_ps(setup.a1), a2s = _mm_set1_ps(setup.a2), azs = _mm_set1_ps(setup.az);
+
+		for (int y{ minY }; y < maxY; ++y)
+		{
+			float* pRow = m_pDepth + y * m_Pitch;
+			const float fy = static_cast<float>(y) - setup.y0;
+
+			// everything that only depends on the row
+			const __m128 row0 = _mm_set1_ps(setup.b0 * fy + 1.f);
+			const __m128 row1 = _mm_set1_ps(setup.b1 * fy);
+			const __m128 row2 = _mm_set1_ps(setup.b2 * fy);
+			const __m128 rowZ = _mm_set1_ps(setup.bz * fy + setup.cz);
+
+			int x{ minX };
+
+			for (; x + 4 <= maxX; x += 4)
+			{
+				// column numbers are exact in float, only subtracting v0 rounds
+				const __m128 px = _mm_sub_ps(_mm_add_ps(_mm_set1_ps(static_cast<float>(x)), columnOffsets), x0s);
+
+				const __m128 w0 = _mm_add_ps(_mm_mul_ps(a0s, px), row0);
+				const __m128 w1 = _mm_add_ps(_mm_mul_ps(a1s, px), row1);
+				const __m128 w2 = _mm_add_ps(_mm_mul_ps(a2s, px), row2);
+				__m128 z = _mm_add_ps(_mm_mul_ps(azs, px), rowZ);
+
+				if (m_IsReciprocal)
+				{
+					z = _mm_div_ps(one, z);
+				}
+
+				__m128 mask = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)), _mm_cmpge_ps(w2, zero));
+				mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(z, zero), _mm_cmple_ps(z, one)));
+
+				if (_mm_movemask_ps(mask) == 0)
+				{
+					continue;
+				}
+
+				const __m128 stored = _mm_loadu_ps(pRow + x);
+				mask = _mm_and_ps(mask, m_IsReversed ? _mm_cmpge_ps(z, stored) : _mm_cmple_ps(z, stored));
+
+				_mm_storeu_ps(pRow + x, _mm_or_ps(_mm_and_ps(mask, z), _mm_andnot_ps(mask, stored)));
+			}
+
+			// the last columns that don't fill a whole group
+			for (; x < maxX; ++x)
+			{
+				float w0, w1, w2, z;
+
+				if (!setup.Evaluate(x, y, w0, w1, w2, z) || (m_IsReversed ? z < pRow[x] : z > pRow[x]))
+				{
+					continue;
+				}
+
+				pRow[x] = z;
+			}
+		}
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "Vector3.h"
+
+namespace dae
+{
+	// depth only triangle rasterizer: no attributes, no shading, 4 pixels per step with SSE.
+	// renders into a buffer it doesn't own, used for shadow maps & the depth prepass
+	class DepthRasterizer final
+	{
+	public:
+		// barycentric weights & depth of a triangle as planes over the screen, relative to v0.
+		// the depth prepass evaluates the same setup in the shading pass, so both get bit identical coverage & depth
+		struct TriangleSetup
+		{
+			float a0{}, b0{}, a1{}, b1{}, a2{}, b2{};
+			float az{}, bz{}, cz{};
+			float x0{}, y0{};
+			bool isReciprocal = false;
+
+			// false for triangles without area
+			bool Initialize(const Vector3& v0, const Vector3& v1, const Vector3& v2, bool reciprocal);
+
+			// at pixel (x, y), false when it's outside the triangle or the depth outside [0, 1]
+			bool Evaluate(int x, int y, float& w0, float& w1, float& w2, float& z) const
+			{
+				const float fx = static_cast<float>(x) - x0;
+				const float fy = static_cast<float>(y) - y0;
+
+				w0 = a0 * fx + (b0 * fy + 1.f);
+				w1 = a1 * fx + b1 * fy;
+				w2 = a2 * fx + b2 * fy;
+
+				if (w0 < 0.f || w1 < 0.f || w2 < 0.f)
+				{
+					return false;
+				}
+
+				z = az * fx + (bz * fy + cz);
+
+				if (isReciprocal)
+				{
+					z = 1.f / z;
+				}
+
+				return z >= 0.f && z <= 1.f;
+			};
+		};
+
+		DepthRasterizer() = default;
+
+		DepthRasterizer(const DepthRasterizer&) = delete;
+		DepthRasterizer(DepthRasterizer&&) noexcept = delete;
+		DepthRasterizer& operator=(const DepthRasterizer&) = delete;
+		DepthRasterizer& operator=(DepthRasterizer&&) noexcept = delete;
+
+		// pitch in floats. with reversed depth, greater values are closer.
+		// reciprocal depth interpolates 1 / z & inverts it per pixel, the way forward depth is interpolated in the software renderer
+		void SetTarget(float* pDepth, int width, int height, int pitch, bool isReversed, bool isReciprocal = false);
+
+		// screen space xy with pixel centers on integer coordinates, depth in z, interpolated linearly in screen space (or its reciprocal).
+		// both windings get drawn, only pixels in [left, right) x [top, bottom) are touched
+		void RasterizeTriangle(const Vector3& v0, const Vector3& v1, const Vector3& v2, int left, int top, int right, int bottom) const;
+
+	private:
+		float* m_pDepth{ nullptr };
+		int m_Width{};
+		int m_Height{};
+		int m_Pitch{};
+		bool m_IsReversed = false;
+		bool m_IsReciprocal = false;
+	};
+}
@@ -1,10 +1,14 @@
 ﻿#include "pch.h"
 #include "Effect.h"
+#include "SoftwareShader.h"
 
 #include <sstream>
 
-Effect::Effect(ID3D11Device* pDevice)
-	: BaseEffect(pDevice, L"Resources/PosCol3D.fx")
+Effect::Effect(ID3D11Device* pDevice, AssetFuture<Texture*> diffuseLoad, AssetFuture<Texture*> normalLoad, AssetFuture<Texture*> specularLoad, AssetFuture<Texture*> glossLoad)
+	: BaseEffect(pDevice, L"Resources/PosCol3D.fx", diffuseLoad)
+	, m_NormalLoad(normalLoad)
+	, m_SpecularLoad(specularLoad)
+	, m_GlossLoad(glossLoad)
 {
 	//--------------------------------
 	// Matrices
@@ -45,23 +49,12 @@ Effect::Effect(ID3D11Device* pDevice)
 	{
 		std::wcout << L"GlossinessMap is invalid.\n";
 	}
-
-	// set textures
-	m_pTexture = Texture::LoadFromFile(pDevice, "Resources/vehicle_diffuse.png");
-	SetDiffuseMap(m_pTexture);
-
-	m_pNormal = Texture::LoadFromFile(pDevice, "Resources/vehicle_normal.png");
-	SetNormalMap(m_pNormal);
-
-	m_pSpecular = Texture::LoadFromFile(pDevice, "Resources/vehicle_specular.png");
-	SetSpecularMap(m_pSpecular);
-
-	m_pGloss = Texture::LoadFromFile(pDevice, "Resources/vehicle_gloss.png");
-	SetGlossMap(m_pGloss);
 }
 
 Effect::~Effect()
 {
+	FinishLoading();
+
 	m_pSpecularMap->Release();
 	m_pNormalMap->Release();
 	m_pGlossMap->Release();
@@ -71,26 +64,52 @@ Effect::~Effect()
 	delete m_pGloss;
 	delete m_pSpecular;
 	delete m_pNormal;
-	delete m_pTexture;
+}
+
+ShaderProgram Effect::GetSoftwareShader() const
+{
+	return ShaderProgram::Effect;
+}
+
+void Effect::FinishLoading()
+{
+	if (m_IsLoaded)
+	{
+		return;
+	}
+
+	m_pNormal = m_NormalLoad.Get();
+	m_pSpecular = m_SpecularLoad.Get();
+	m_pGloss = m_GlossLoad.Get();
+
+	SetNormalMap(m_pNormal);
+	SetSpecularMap(m_pSpecular);
+	SetGlossMap(m_pGloss);
+
+	BaseEffect::FinishLoading();
 }
 
 Texture* Effect::GetTexture()
 {
+	FinishLoading();
 	return m_pTexture;
 }
 
 Texture* Effect::GetNormal()
 {
+	FinishLoading();
 	return m_pNormal;
 }
 
 Texture* Effect::GetGloss()
 {
+	FinishLoading();
 	return m_pGloss;
 }
 
 Texture* Effect::GetSpecular()
 {
+	FinishLoading();
 	return m_pSpecular;
 }
 
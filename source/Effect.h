@@ -7,10 +7,11 @@ using namespace dae;
 class Effect : public BaseEffect
 {
 public:
-	Effect(ID3D11Device* pDevice);
+	Effect(ID3D11Device* pDevice, AssetFuture<Texture*> diffuseLoad, AssetFuture<Texture*> normalLoad, AssetFuture<Texture*> specularLoad, AssetFuture<Texture*> glossLoad);
 	~Effect();
 
 	ID3D11InputLayout* CreateInputLayout(ID3D11Device* pDevice);
+	ShaderProgram GetSoftwareShader() const override;
 
 	ID3DX11EffectMatrixVariable* GetWorldMatrix() override;
 	ID3DX11EffectMatrixVariable* GetViewInverseMatrix() override;
@@ -20,6 +21,8 @@ public:
 	Texture* GetGloss() override;
 	Texture* GetSpecular() override;
 
+	void FinishLoading() override;
+
 	void SetNormalMap(Texture* pNormalMap);
 	void SetSpecularMap(Texture* pSpecularMap);
 	void SetGlossMap(Texture* pGlossMap);
@@ -32,8 +35,11 @@ private:
 	ID3DX11EffectShaderResourceVariable* m_pSpecularMap;
 	ID3DX11EffectShaderResourceVariable* m_pGlossMap;
 
-	Texture* m_pTexture;
-	Texture* m_pNormal;
-	Texture* m_pSpecular;
-	Texture* m_pGloss;
+	Texture* m_pNormal{};
+	Texture* m_pSpecular{};
+	Texture* m_pGloss{};
+
+	AssetFuture<Texture*> m_NormalLoad;
+	AssetFuture<Texture*> m_SpecularLoad;
+	AssetFuture<Texture*> m_GlossLoad;
 };
@@ -0,0 +1,92 @@
+#include "pch.h"
+#include "FrameOutput.h"
+
+namespace dae
+{
+	FrameOutput::FrameOutput(uint32_t pixelFormat, int width, int height, int frameCount)
+		: m_Frames(frameCount)
+	{
+		// same format as the rendered frames, so submitting is a straight copy
+		for (Frame& frame : m_Frames)
+		{
+			frame.pSurface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, pixelFormat);
+		}
+
+		m_Thread = std::thread(&FrameOutput::Run, this);
+	}
+
+	FrameOutput::~FrameOutput()
+	{
+		Flush();
+
+		// bump the write index to wake the output thread, it sees it should stop before writing anything
+		m_IsRunning = false;
+		m_WriteIndex.fetch_add(1, std::memory_order_release);
+		m_WriteIndex.notify_one();
+		m_Thread.join();
+
+		for (Frame& frame : m_Frames)
+		{
+			SDL_FreeSurface(frame.pSurface);
+		}
+	}
+
+	bool FrameOutput::Submit(SDL_Surface* pSource, const std::string& path)
+	{
+		const uint32_t write = m_WriteIndex.load(std::memory_order_relaxed);
+
+		// only happens when images get requested faster than the disk takes them
+		if (write - m_ReadIndex.load(std::memory_order_acquire) >= m_Frames.size())
+		{
+			return false;
+		}
+
+		Frame& frame = m_Frames[write % m_Frames.size()];
+		SDL_BlitSurface(pSource, 0, frame.pSurface, 0);
+		frame.path = path;
+
+		m_WriteIndex.store(write + 1, std::memory_order_release);
+		m_WriteIndex.notify_one();
+		return true;
+	}
+
+	void FrameOutput::Flush()
+	{
+		const uint32_t write = m_WriteIndex.load(std::memory_order_relaxed);
+		uint32_t read = m_ReadIndex.load(std::memory_order_acquire);
+
+		while (read != write)
+		{
+			m_ReadIndex.wait(read, std::memory_order_acquire);
+			read = m_ReadIndex.load(std::memory_order_acquire);
+		}
+	}
+
+	void FrameOutput::Run()
+	{
+		uint32_t read = m_ReadIndex.load(std::memory_order_relaxed);
+
+		while (true)
+		{
+			const uint32_t write = m_WriteIndex.load(std::memory_order_acquire);
+
+			if (!m_IsRunning)
+			{
+				break;
+			}
+
+			if (read == write)
+			{
+				m_WriteIndex.wait(write, std::memory_order_acquire);
+				continue;
+			}
+
+			const Frame& frame = m_Frames[read % m_Frames.size()];
+			SDL_SaveBMP(frame.pSurface, frame.path.c_str());
+
+			++read;
+			m_ReadIndex.store(read, std::memory_order_release);
+			m_ReadIndex.notify_one();
+		}
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct SDL_Surface;
+
+namespace dae
+{
+	// ring of finished frames a dedicated thread writes to disk, so saving an image never stalls the render thread.
+	// presenting stays on the render thread: SDL only allows window calls on the thread that created the window,
+	// and frames rendered straight into the window surface leave nothing to hand off. the threads only share the ring indices
+	class FrameOutput final
+	{
+	public:
+		FrameOutput(uint32_t pixelFormat, int width, int height, int frameCount = 3);
+		~FrameOutput();
+
+		FrameOutput(const FrameOutput&) = delete;
+		FrameOutput(FrameOutput&&) noexcept = delete;
+		FrameOutput& operator=(const FrameOutput&) = delete;
+		FrameOutput& operator=(FrameOutput&&) noexcept = delete;
+
+		// render thread only. copies pSource into the ring, the output thread writes it to path.
+		// false without waiting when every frame of the ring is still being written
+		bool Submit(SDL_Surface* pSource, const std::string& path);
+		// waits until every submitted frame is written
+		void Flush();
+
+	private:
+		struct Frame
+		{
+			SDL_Surface* pSurface{ nullptr };
+			std::string path;
+		};
+
+		std::vector<Frame> m_Frames;
+
+		// monotonically increasing, the frame index is the counter modulo the ring size.
+		// submitted by the render thread, written by the output thread
+		std::atomic<uint32_t> m_WriteIndex{};
+		std::atomic<uint32_t> m_ReadIndex{};
+		std::atomic<bool> m_IsRunning{ true };
+
+		std::thread m_Thread;
+
+		void Run();
+	};
+}
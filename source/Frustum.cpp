@@ -0,0 +1,61 @@
+#include "pch.h"
+#include "Frustum.h"
+
+namespace dae
+{
+	Frustum::Frustum(const Matrix& viewProjection)
+	{
+		// row vectors (p * M), so the planes are combinations of the matrix columns
+		const Matrix& m = viewProjection;
+		const Vector4 column0{ m[0].x, m[1].x, m[2].x, m[3].x };
+		const Vector4 column1{ m[0].y, m[1].y, m[2].y, m[3].y };
+		const Vector4 column2{ m[0].z, m[1].z, m[2].z, m[3].z };
+		const Vector4 column3{ m[0].w, m[1].w, m[2].w, m[3].w };
+
+		planes[0] = column3 + column0; // left
+		planes[1] = column3 - column0; // right
+		planes[2] = column3 + column1; // bottom
+		planes[3] = column3 - column1; // top
+		planes[4] = column2;           // near (z in [0, 1])
+		planes[5] = column3 - column2; // far
+
+		for (Vector4& plane : planes)
+		{
+			const float length = plane.GetXYZ().Magnitude();
+			plane = plane * (1.f / length);
+		}
+	}
+
+	bool Frustum::IsSphereVisible(const Vector3& center, float radius) const
+	{
+		for (const Vector4& plane : planes)
+		{
+			if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool Frustum::IsBoxVisible(const Vector3& min, const Vector3& max) const
+	{
+		for (const Vector4& plane : planes)
+		{
+			// corner furthest along the plane normal, if that one's outside the whole box is
+			const Vector3 corner{
+				plane.x >= 0.f ? max.x : min.x,
+				plane.y >= 0.f ? max.y : min.y,
+				plane.z >= 0.f ? max.z : min.z
+			};
+
+			if (plane.x * corner.x + plane.y * corner.y + plane.z * corner.z + plane.w < 0.f)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+}
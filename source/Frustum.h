@@ -0,0 +1,20 @@
+#pragma once
+#include "Vector3.h"
+#include "Vector4.h"
+#include "Matrix.h"
+
+namespace dae
+{
+	struct Frustum
+	{
+		// (normal, distance) per plane, normals point inwards: dot(normal, p) + distance >= 0 is inside
+		Vector4 planes[6]{};
+
+		Frustum() = default;
+		// planes end up in the space the matrix transforms from, pass a worldViewProjection to test in object space
+		explicit Frustum(const Matrix& viewProjection);
+
+		bool IsSphereVisible(const Vector3& center, float radius) const;
+		bool IsBoxVisible(const Vector3& min, const Vector3& max) const;
+	};
+}
@@ -80,6 +80,11 @@ namespace dae
 		{
 			for (size_t i = 0; i < meshes.size(); i++)
 			{
+				if (meshes[i]->IsCulled())
+				{
+					continue;
+				}
+
 				meshes[i]->Render(m_pDeviceContext, meshes[i]->GetWorldMatrix() * m_pCamera->viewMatrix * m_pCamera->projectionMatrix);
 			}
 		}
@@ -87,6 +92,11 @@ namespace dae
 		{
 			for (size_t i = 0; i < std::min<size_t>(meshes.size(), 1); i++)
 			{
+				if (meshes[i]->IsCulled())
+				{
+					continue;
+				}
+
 				meshes[i]->Render(m_pDeviceContext, meshes[i]->GetWorldMatrix() * m_pCamera->viewMatrix * m_pCamera->projectionMatrix);
 			}
 		}
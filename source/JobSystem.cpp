@@ -0,0 +1,283 @@
+#include "pch.h"
+#include "JobSystem.h"
+#include <cassert>
+
+namespace dae
+{
+	JobSystem* JobSystem::s_pInstance{ nullptr };
+	thread_local int JobSystem::s_WorkerIndex{ -1 };
+
+	JobSystem::JobSystem(uint32_t threadCount)
+	{
+		assert(!s_pInstance && "only one job system");
+		s_pInstance = this;
+
+		if (threadCount == 0)
+		{
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+		}
+
+		for (uint32_t i = 0; i < threadCount; ++i)
+		{
+			m_Workers.push_back(std::make_unique<Worker>());
+		}
+
+		s_WorkerIndex = 0;
+
+		for (uint32_t i = 1; i < threadCount; ++i)
+		{
+			m_Threads.emplace_back(&JobSystem::WorkerLoop, this, static_cast<int>(i));
+		}
+	}
+
+	JobSystem::~JobSystem()
+	{
+		{
+			std::lock_guard lock{ m_SleepMutex };
+			m_IsRunning = false;
+		}
+
+		m_WakeUp.notify_all();
+
+		for (std::thread& thread : m_Threads)
+		{
+			thread.join();
+		}
+
+		s_WorkerIndex = -1;
+		s_pInstance = nullptr;
+	}
+
+	JobSystem& JobSystem::Get()
+	{
+		assert(s_pInstance && "create the job system before using it");
+		return *s_pInstance;
+	}
+
+	void JobSystem::Run(Job job, Counter* pCounter)
+	{
+		if (pCounter)
+		{
+			pCounter->m_Pending.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		Task task{ std::move(job), pCounter };
+
+		// deterministic mode, nothing is ever deferred
+		if (IsSingleThreaded())
+		{
+			Execute(task);
+			return;
+		}
+
+		Push(std::move(task));
+	}
+
+	void JobSystem::RunAfter(Counter& dependency, Job job, Counter* pCounter)
+	{
+		// counted right away, so waiting on pCounter also covers jobs that didn't start yet
+		if (pCounter)
+		{
+			pCounter->m_Pending.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		{
+			std::lock_guard lock{ dependency.m_Mutex };
+
+			if (!dependency.IsDone())
+			{
+				dependency.m_Continuations.emplace_back(std::move(job), pCounter);
+				return;
+			}
+		}
+
+		Task task{ std::move(job), pCounter };
+
+		if (IsSingleThreaded())
+		{
+			Execute(task);
+			return;
+		}
+
+		Push(std::move(task));
+	}
+
+	void JobSystem::ParallelFor(size_t count, size_t grainSize, const std::function<void(size_t begin, size_t end)>& job)
+	{
+		grainSize = std::max<size_t>(grainSize, 1);
+
+		if (count == 0)
+		{
+			return;
+		}
+
+		if (IsSingleThreaded() || count <= grainSize)
+		{
+			for (size_t begin = 0; begin < count; begin += grainSize)
+			{
+				job(begin, std::min(begin + grainSize, count));
+			}
+
+			return;
+		}
+
+		Counter counter{};
+
+		for (size_t begin = 0; begin < count; begin += grainSize)
+		{
+			const size_t end = std::min(begin + grainSize, count);
+			Run([&job, begin, end]() { job(begin, end); }, &counter);
+		}
+
+		Wait(counter);
+	}
+
+	void JobSystem::Wait(const Counter& counter)
+	{
+		while (!counter.IsDone())
+		{
+			if (!TryRunOne())
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		// the job that brought it to zero might still be inside Finish, holding the counter's lock
+		std::lock_guard lock{ counter.m_Mutex };
+	}
+
+	void JobSystem::Push(Task task)
+	{
+		// threads outside the pool hand their jobs to the main thread's deque, from where they get stolen
+		Worker& worker = *m_Workers[std::max(s_WorkerIndex, 0)];
+
+		{
+			std::lock_guard lock{ worker.mutex };
+			worker.tasks.push_back(std::move(task));
+		}
+
+		// taking the lock makes sure a worker checking for work either sees the task or gets woken
+		{
+			std::lock_guard lock{ m_SleepMutex };
+			m_QueuedTasks.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		m_WakeUp.notify_one();
+	}
+
+	bool JobSystem::TryPop(Task& task)
+	{
+		const int workerCount = static_cast<int>(m_Workers.size());
+		const int self = s_WorkerIndex;
+
+		// own work first, newest first while it's still warm in the cache
+		if (self >= 0)
+		{
+			Worker& worker = *m_Workers[self];
+			std::lock_guard lock{ worker.mutex };
+
+			if (!worker.tasks.empty())
+			{
+				task = std::move(worker.tasks.back());
+				worker.tasks.pop_back();
+				m_QueuedTasks.fetch_sub(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+
+		// steal the oldest job of someone else
+		for (int offset = 1; offset <= workerCount; ++offset)
+		{
+			const int victim = (std::max(self, 0) + offset) % workerCount;
+
+			if (victim == self)
+			{
+				continue;
+			}
+
+			Worker& worker = *m_Workers[victim];
+			std::lock_guard lock{ worker.mutex };
+
+			if (!worker.tasks.empty())
+			{
+				task = std::move(worker.tasks.front());
+				worker.tasks.pop_front();
+				m_QueuedTasks.fetch_sub(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool JobSystem::TryRunOne()
+	{
+		Task task{};
+
+		if (!TryPop(task))
+		{
+			return false;
+		}
+
+		Execute(task);
+		return true;
+	}
+
+	void JobSystem::Execute(Task& task)
+	{
+		task.job();
+		Finish(task.pCounter);
+	}
+
+	void JobSystem::Finish(Counter* pCounter)
+	{
+		if (!pCounter)
+		{
+			return;
+		}
+
+		// the counter may be gone as soon as a waiter sees it hit zero, so continuations are taken out under its lock first
+		std::vector<std::pair<Job, Counter*>> continuations;
+
+		{
+			std::lock_guard lock{ pCounter->m_Mutex };
+
+			if (pCounter->m_Pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+			{
+				return;
+			}
+
+			continuations.swap(pCounter->m_Continuations);
+		}
+
+		for (auto& [job, pContinuationCounter] : continuations)
+		{
+			Task task{ std::move(job), pContinuationCounter };
+
+			if (IsSingleThreaded())
+			{
+				Execute(task);
+			}
+			else
+			{
+				Push(std::move(task));
+			}
+		}
+	}
+
+	void JobSystem::WorkerLoop(int workerIndex)
+	{
+		s_WorkerIndex = workerIndex;
+
+		while (m_IsRunning)
+		{
+			if (TryRunOne())
+			{
+				continue;
+			}
+
+			std::unique_lock lock{ m_SleepMutex };
+			m_WakeUp.wait(lock, [this]() { return m_QueuedTasks.load(std::memory_order_relaxed) > 0 || !m_IsRunning; });
+		}
+	}
+}
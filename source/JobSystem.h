@@ -0,0 +1,98 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	// work stealing scheduler shared by everything that wants to go wide,
+	// every worker owns a deque: it pushes & pops at the back, idle workers steal from the front.
+	// the thread that created it (main) is worker 0 and only runs jobs while it waits
+	class JobSystem final
+	{
+	public:
+		using Job = std::function<void()>;
+
+		// number of unfinished jobs of a group, jobs can be made to wait on it with RunAfter
+		class Counter final
+		{
+		public:
+			Counter() = default;
+
+			Counter(const Counter&) = delete;
+			Counter(Counter&&) noexcept = delete;
+			Counter& operator=(const Counter&) = delete;
+			Counter& operator=(Counter&&) noexcept = delete;
+
+			bool IsDone() const { return m_Pending.load(std::memory_order_acquire) == 0; };
+
+		private:
+			friend class JobSystem;
+
+			std::atomic<uint32_t> m_Pending{ 0 };
+			mutable std::mutex m_Mutex;
+			std::vector<std::pair<Job, Counter*>> m_Continuations;
+		};
+
+		// threadCount includes the calling thread, 0 uses every core.
+		// 1 runs every job immediately on the submitting thread, in submission order
+		explicit JobSystem(uint32_t threadCount = 0);
+		~JobSystem();
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem(JobSystem&&) noexcept = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+		JobSystem& operator=(JobSystem&&) noexcept = delete;
+
+		// the one created in main
+		static JobSystem& Get();
+
+		uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_Workers.size()); };
+		bool IsSingleThreaded() const { return m_Workers.size() == 1; };
+
+		void Run(Job job, Counter* pCounter = nullptr);
+		// only starts once every job counted by dependency finished
+		void RunAfter(Counter& dependency, Job job, Counter* pCounter = nullptr);
+		// calls job with [begin, end) ranges of at most grainSize elements, returns when all of them ran
+		void ParallelFor(size_t count, size_t grainSize, const std::function<void(size_t begin, size_t end)>& job);
+		// runs other jobs instead of blocking, so waiting from inside a job can't starve the pool
+		void Wait(const Counter& counter);
+
+	private:
+		struct Task
+		{
+			Job job;
+			Counter* pCounter{ nullptr };
+		};
+
+		struct Worker
+		{
+			std::mutex mutex;
+			std::deque<Task> tasks;
+		};
+
+		static JobSystem* s_pInstance;
+		// -1 on threads that aren't part of the pool
+		static thread_local int s_WorkerIndex;
+
+		std::vector<std::unique_ptr<Worker>> m_Workers;
+		std::vector<std::thread> m_Threads;
+
+		std::atomic<bool> m_IsRunning{ true };
+		std::atomic<uint32_t> m_QueuedTasks{ 0 };
+		std::mutex m_SleepMutex;
+		std::condition_variable m_WakeUp;
+
+		void Push(Task task);
+		bool TryPop(Task& task);
+		bool TryRunOne();
+		void Execute(Task& task);
+		void Finish(Counter* pCounter);
+		void WorkerLoop(int workerIndex);
+	};
+}
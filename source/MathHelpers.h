@@ -1,5 +1,8 @@
 #pragma once
 #include <cmath>
+#include <bit>
+#include <cstdint>
+#include <xmmintrin.h>
 
 namespace dae
 {
@@ -56,4 +59,40 @@ namespace dae
 		if (v > 1.f) return 1.f;
 		return v;
 	}
-}
\ No newline at end of file
+
+	/* --- FAST APPROXIMATIONS --- */
+	// exponent bits plus a cubic-in-mantissa polynomial, absolute error below 2e-4
+	inline float FastLog2(float v)
+	{
+		const uint32_t bits = std::bit_cast<uint32_t>(v);
+		const float exponent = float(int((bits >> 23) & 255) - 127);
+		const float t = std::bit_cast<float>((bits & 0x007FFFFF) | 0x3F800000) - 1.f;
+
+		return exponent + t * (1.43854679f + t * (-0.678081486f + t * (0.323630368f + t * -0.0842850926f)));
+	}
+
+	// integer part goes straight into the exponent bits, relative error below 1e-5
+	inline float FastExp2(float v)
+	{
+		if (v < -126.f) return 0.f;
+
+		const float whole = floorf(v);
+		const float f = v - whole;
+		const float p = 1.f + f * (0.693018631f + f * (0.241404768f + f * (0.0520739356f + f * 0.0134934755f)));
+
+		return std::bit_cast<float>(std::bit_cast<int32_t>(p) + (int32_t(whole) << 23));
+	}
+
+	inline float FastPow(float base, float exponent)
+	{
+		if (base <= 0.f) return 0.f;
+		return FastExp2(exponent * FastLog2(base));
+	}
+
+	// hardware estimate (12 bits) refined by one Newton-Raphson step
+	inline float FastInvSqrt(float v)
+	{
+		const float r = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(v)));
+		return r * (1.5f - 0.5f * v * r * r);
+	}
+}
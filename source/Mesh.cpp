@@ -2,13 +2,15 @@
 #include "Mesh.h"
 #include "Effect.h"
 #include "Utils.h"
+#include "MeshSimplifier.h"
 
 Mesh::Mesh(ID3D11Device* pDevice, BaseEffect* pEffect, const std::string& filePath)
 	: m_pEffect(pEffect)
 {
 	Utils::ParseOBJ(filePath, m_Vertices, m_Indices);
-
-	m_pVertexLayout = m_pEffect->CreateInputLayout(pDevice);
+	CalculateBounds();
+	BuildLods();
+	BuildMeshlets();
 
 	// create vertex buffer
 	D3D11_BUFFER_DESC bd = {};
@@ -53,6 +55,15 @@ void Mesh::Render(ID3D11DeviceContext* pDeviceContext, const Matrix& worldViewPr
 	// Set primitive topology
 	pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
+	// meshes can be loaded on a worker while the main thread uses the effect, so the layout gets made on first use
+	if (!m_pVertexLayout)
+	{
+		ID3D11Device* pDevice{};
+		pDeviceContext->GetDevice(&pDevice);
+		m_pVertexLayout = m_pEffect->CreateInputLayout(pDevice);
+		pDevice->Release();
+	}
+
 	// Set input layout
 	pDeviceContext->IASetInputLayout(m_pVertexLayout);
 
@@ -88,7 +99,7 @@ void Mesh::Render(ID3D11DeviceContext* pDeviceContext, const Matrix& worldViewPr
 	for (UINT i = 0; i < techDesc.Passes; i++)
 	{
 		m_pEffect->GetTechnique()->GetPassByIndex(0)->Apply(0, pDeviceContext);
-		pDeviceContext->DrawIndexed(m_AmountIndices, 0, 0);
+		pDeviceContext->DrawIndexed(m_Lods[m_Lod].indexCount, m_Lods[m_Lod].indexOffset, 0);
 	}
 }
 
@@ -102,16 +113,293 @@ Matrix Mesh::GetWorldMatrix()
 	return m_MatWorld;
 }
 
-std::vector<Mesh::Vertex_In> Mesh::GetVertices()
+const std::vector<Mesh::Vertex_In>& Mesh::GetVertices() const
 {
 	return m_Vertices;
 }
 
-std::vector<uint32_t> Mesh::GetIndices()
+const std::vector<uint32_t>& Mesh::GetIndices() const
 {
 	return m_Indices;
 }
 
+void Mesh::CalculateBounds()
+{
+	if (m_Vertices.empty())
+	{
+		return;
+	}
+
+	m_BoundsMin = m_Vertices[0].position;
+	m_BoundsMax = m_Vertices[0].position;
+
+	for (const Vertex_In& vertex : m_Vertices)
+	{
+		m_BoundsMin.x = std::min(m_BoundsMin.x, vertex.position.x);
+		m_BoundsMin.y = std::min(m_BoundsMin.y, vertex.position.y);
+		m_BoundsMin.z = std::min(m_BoundsMin.z, vertex.position.z);
+		m_BoundsMax.x = std::max(m_BoundsMax.x, vertex.position.x);
+		m_BoundsMax.y = std::max(m_BoundsMax.y, vertex.position.y);
+		m_BoundsMax.z = std::max(m_BoundsMax.z, vertex.position.z);
+	}
+
+	// centered on the box, but the radius only as big as the furthest vertex
+	m_BoundingSphereCenter = (m_BoundsMin + m_BoundsMax) * 0.5f;
+	float sqrRadius = 0.f;
+
+	for (const Vertex_In& vertex : m_Vertices)
+	{
+		sqrRadius = std::max(sqrRadius, (vertex.position - m_BoundingSphereCenter).SqrMagnitude());
+	}
+
+	m_BoundingSphereRadius = sqrtf(sqrRadius);
+}
+
+int Mesh::SelectLod(float screenRadius, float fullDetailRadius) const
+{
+	int lod = 0;
+	float threshold = fullDetailRadius;
+
+	while (lod + 1 < static_cast<int>(m_Lods.size()) && screenRadius < threshold)
+	{
+		++lod;
+		threshold *= 0.5f;
+	}
+
+	return lod;
+}
+
+void Mesh::BuildLods()
+{
+	m_Lods.clear();
+	m_Lods.push_back({ 0, static_cast<uint32_t>(m_Indices.size()) });
+	m_Lod = 0;
+
+	if (m_Topology == PrimitiveTopology::TriangleList)
+	{
+		BuildLodLevels();
+	}
+
+	// simplified levels only keep part of the vertices, the rest don't need to be transformed
+	m_LodVertices.clear();
+	std::vector<bool> isUsed(m_Vertices.size());
+
+	for (Lod& lod : m_Lods)
+	{
+		std::fill(isUsed.begin(), isUsed.end(), false);
+
+		for (uint32_t i = lod.indexOffset; i < lod.indexOffset + lod.indexCount; ++i)
+		{
+			isUsed[m_Indices[i]] = true;
+		}
+
+		lod.vertexOffset = static_cast<uint32_t>(m_LodVertices.size());
+
+		for (uint32_t vertex = 0; vertex < isUsed.size(); ++vertex)
+		{
+			if (isUsed[vertex])
+			{
+				m_LodVertices.push_back(vertex);
+			}
+		}
+
+		lod.vertexCount = static_cast<uint32_t>(m_LodVertices.size()) - lod.vertexOffset;
+	}
+}
+
+void Mesh::BuildLodLevels()
+{
+	// every level gets appended to the index buffer, simplified from the previous one
+	std::vector<uint32_t> source = m_Indices;
+
+	while (m_Lods.size() < MaxLods)
+	{
+		std::vector<uint32_t> simplified = MeshSimplifier::Simplify(m_Vertices, source, source.size() / 3 / 2);
+
+		// only borders left to collapse, another level wouldn't save anything
+		if (simplified.empty() || simplified.size() * 10 > source.size() * 9)
+		{
+			break;
+		}
+
+		m_Lods.push_back({ static_cast<uint32_t>(m_Indices.size()), static_cast<uint32_t>(simplified.size()) });
+		m_Indices.insert(m_Indices.end(), simplified.begin(), simplified.end());
+		source = std::move(simplified);
+	}
+}
+
+void Mesh::BuildMeshlets()
+{
+	m_Meshlets.clear();
+	m_MeshletVertices.clear();
+	m_MeshletTriangles.clear();
+
+	if (m_Topology != PrimitiveTopology::TriangleList)
+	{
+		return;
+	}
+
+	// slot of a vertex inside the meshlet being built, -1 when it isn't part of it
+	std::vector<int> localIndices(m_Vertices.size(), -1);
+	Meshlet meshlet{};
+
+	auto finishMeshlet = [&]()
+	{
+		for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+		{
+			localIndices[m_MeshletVertices[meshlet.vertexOffset + i]] = -1;
+		}
+
+		CalculateMeshletBounds(meshlet);
+		m_Meshlets.push_back(meshlet);
+
+		meshlet = {};
+		meshlet.vertexOffset = static_cast<uint32_t>(m_MeshletVertices.size());
+		meshlet.triangleOffset = static_cast<uint32_t>(m_MeshletTriangles.size() / 3);
+	};
+
+	// greedy in index order, keeps neighbouring triangles together as long as the index buffer does
+	for (size_t i = 0; i + 2 < m_Lods[0].indexCount; i += 3)
+	{
+		uint32_t newVertices = 0;
+
+		for (size_t corner = 0; corner < 3; ++corner)
+		{
+			if (localIndices[m_Indices[i + corner]] < 0)
+			{
+				++newVertices;
+			}
+		}
+
+		if (meshlet.vertexCount + newVertices > MaxMeshletVertices || meshlet.triangleCount + 1 > MaxMeshletTriangles)
+		{
+			finishMeshlet();
+		}
+
+		for (size_t corner = 0; corner < 3; ++corner)
+		{
+			const uint32_t index = m_Indices[i + corner];
+
+			if (localIndices[index] < 0)
+			{
+				localIndices[index] = static_cast<int>(meshlet.vertexCount++);
+				m_MeshletVertices.push_back(index);
+			}
+
+			m_MeshletTriangles.push_back(static_cast<uint8_t>(localIndices[index]));
+		}
+
+		++meshlet.triangleCount;
+	}
+
+	if (meshlet.triangleCount > 0)
+	{
+		finishMeshlet();
+	}
+}
+
+void Mesh::CalculateMeshletBounds(Meshlet& meshlet) const
+{
+	const uint32_t* pVertices = &m_MeshletVertices[meshlet.vertexOffset];
+	const uint8_t* pTriangles = &m_MeshletTriangles[meshlet.triangleOffset * 3];
+
+	// bounding sphere
+	Vector3 min = m_Vertices[pVertices[0]].position;
+	Vector3 max = min;
+
+	for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+	{
+		const Vector3& position = m_Vertices[pVertices[i]].position;
+		min = { std::min(min.x, position.x), std::min(min.y, position.y), std::min(min.z, position.z) };
+		max = { std::max(max.x, position.x), std::max(max.y, position.y), std::max(max.z, position.z) };
+	}
+
+	meshlet.center = (min + max) * 0.5f;
+	float sqrRadius = 0.f;
+
+	for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+	{
+		sqrRadius = std::max(sqrRadius, (m_Vertices[pVertices[i]].position - meshlet.center).SqrMagnitude());
+	}
+
+	meshlet.radius = sqrtf(sqrRadius);
+
+	// normal cone, face normals are oriented along the vertex normals so the winding convention doesn't matter
+	std::vector<Vector3> normals;
+	normals.reserve(meshlet.triangleCount);
+	Vector3 axis{};
+
+	for (uint32_t t = 0; t < meshlet.triangleCount; ++t)
+	{
+		const Vertex_In& v0 = m_Vertices[pVertices[pTriangles[t * 3]]];
+		const Vertex_In& v1 = m_Vertices[pVertices[pTriangles[t * 3 + 1]]];
+		const Vertex_In& v2 = m_Vertices[pVertices[pTriangles[t * 3 + 2]]];
+
+		Vector3 normal = Vector3::Cross(v1.position - v0.position, v2.position - v0.position);
+
+		if (normal.SqrMagnitude() < 1e-12f)
+		{
+			normals.push_back(Vector3::Zero);
+			continue;
+		}
+
+		normal.Normalize();
+
+		if (normal * (v0.normal + v1.normal + v2.normal) < 0.f)
+		{
+			normal = -normal;
+		}
+
+		normals.push_back(normal);
+		axis += normal;
+	}
+
+	meshlet.coneCutoff = 2.f;
+
+	if (axis.SqrMagnitude() < 1e-12f)
+	{
+		return;
+	}
+
+	axis.Normalize();
+
+	float minDot = 1.f;
+
+	for (const Vector3& normal : normals)
+	{
+		if (normal.SqrMagnitude() > 0.f)
+		{
+			minDot = std::min(minDot, normal * axis);
+		}
+	}
+
+	// normals spread over more than a hemisphere, there's always a camera position that sees a front face
+	if (minDot <= 0.f)
+	{
+		return;
+	}
+
+	// push the apex back until it's behind every triangle's plane
+	float maxT = 0.f;
+
+	for (uint32_t t = 0; t < meshlet.triangleCount; ++t)
+	{
+		const Vector3& normal = normals[t];
+
+		if (normal.SqrMagnitude() == 0.f)
+		{
+			continue;
+		}
+
+		const Vector3& p0 = m_Vertices[pVertices[pTriangles[t * 3]]].position;
+		maxT = std::max(maxT, ((meshlet.center - p0) * normal) / (axis * normal));
+	}
+
+	meshlet.coneApex = meshlet.center - axis * maxT;
+	meshlet.coneAxis = axis;
+	meshlet.coneCutoff = sqrtf(1.f - minDot * minDot);
+}
+
 void Mesh::Rotate(float newAngle)
 {
 	
@@ -141,7 +429,10 @@ void Mesh::UpdateSampleState(ID3D11SamplerState* pSampleState)
 
 Mesh::~Mesh()
 {
-	m_pVertexLayout->Release();
+	if (m_pVertexLayout)
+	{
+		m_pVertexLayout->Release();
+	}
 	m_pIndexBuffer->Release();
 	m_pVertexBuffer->Release();
 
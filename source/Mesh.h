@@ -27,8 +27,46 @@ public:
 		Vector2 uv;
 		Vector3 normal;
 		Vector3 tangent;
+		// towards the light & from the camera, in tangent space (software per-vertex tangent space lighting only)
+		Vector3 lightTangent;
+		Vector3 viewTangent;
+		// software point & spot lights only
+		Vector3 worldPosition;
 	};
 
+	// cluster of at most MaxMeshletVertices / MaxMeshletTriangles, so it can be culled as a whole
+	struct Meshlet
+	{
+		// into GetMeshletVertices (mesh vertex indices) & GetMeshletTriangles (3 local indices per triangle)
+		uint32_t vertexOffset{};
+		uint32_t vertexCount{};
+		uint32_t triangleOffset{};
+		uint32_t triangleCount{};
+
+		Vector3 center{};
+		float radius{};
+
+		// every triangle faces away from cameras for which dot(normalize(coneApex - camera), coneAxis) >= coneCutoff
+		Vector3 coneApex{};
+		Vector3 coneAxis{};
+		float coneCutoff{ 2.f };
+	};
+
+	static constexpr uint32_t MaxMeshletVertices = 64;
+	static constexpr uint32_t MaxMeshletTriangles = 124;
+
+	// range of GetIndices, every level of detail shares the vertex buffer.
+	// the vertices its triangles use are a range of GetLodVertices
+	struct Lod
+	{
+		uint32_t indexOffset{};
+		uint32_t indexCount{};
+		uint32_t vertexOffset{};
+		uint32_t vertexCount{};
+	};
+
+	static constexpr int MaxLods = 4;
+
 	enum class PrimitiveTopology
 	{
 		TriangleList,
@@ -43,15 +81,40 @@ public:
 		END = 3
 	};
 
+	// safe to call from a worker, it only uses the device (free threaded) & doesn't touch the effect
 	Mesh(ID3D11Device* pDevice, BaseEffect* pEffect, const std::string& filePath);
 	void Render(ID3D11DeviceContext* pDeviceContext, const Matrix& worldViewProjMatrix, const Matrix& worldMatrix, const Matrix& invViewMatrix);
 	void Render(ID3D11DeviceContext* pDeviceContext, const Matrix& worldViewProjMatrix);
 
 	Matrix GetWorldMatrix();
-	std::vector<Vertex_In> GetVertices();
-	std::vector<uint32_t> GetIndices();
+	const std::vector<Vertex_In>& GetVertices() const;
+	const std::vector<uint32_t>& GetIndices() const;
 	PrimitiveTopology GetPrimitiveTopology() { return m_Topology; };
 
+	// object space bounds, computed once at load
+	const Vector3& GetBoundsMin() const { return m_BoundsMin; };
+	const Vector3& GetBoundsMax() const { return m_BoundsMax; };
+	const Vector3& GetBoundingSphereCenter() const { return m_BoundingSphereCenter; };
+	float GetBoundingSphereRadius() const { return m_BoundingSphereRadius; };
+
+	// level 0 is the source mesh, every next one has about half the triangles
+	const std::vector<Lod>& GetLods() const { return m_Lods; };
+	// sorted, so transforming only a level's vertices still walks the vertex buffer front to back
+	const std::vector<uint32_t>& GetLodVertices() const { return m_LodVertices; };
+	int GetLod() const { return m_Lod; };
+	void SetLod(int lod) { m_Lod = std::clamp(lod, 0, static_cast<int>(m_Lods.size()) - 1); };
+	// level for a bounding sphere projected to screenRadius pixels, the next one gets used below fullDetailRadius and halves per level
+	int SelectLod(float screenRadius, float fullDetailRadius) const;
+
+	// built from level 0
+	const std::vector<Meshlet>& GetMeshlets() const { return m_Meshlets; };
+	const std::vector<uint32_t>& GetMeshletVertices() const { return m_MeshletVertices; };
+	const std::vector<uint8_t>& GetMeshletTriangles() const { return m_MeshletTriangles; };
+
+	// set by the renderer's frustum culling every frame
+	bool IsCulled() const { return m_IsCulled; };
+	void SetCulled(bool isCulled) { m_IsCulled = isCulled; };
+
 	void Rotate(float newAngle);
 	void UpdateRasterizer(ID3D11RasterizerState* rasterizer);
 	void UpdateSampleState(ID3D11SamplerState* pSampleState);
@@ -62,12 +125,33 @@ private:
 	std::vector<Vertex_In> m_Vertices;
 	std::vector<uint32_t> m_Indices;
 
+	std::vector<Lod> m_Lods;
+	std::vector<uint32_t> m_LodVertices;
+	int m_Lod = 0;
+
+	std::vector<Meshlet> m_Meshlets;
+	std::vector<uint32_t> m_MeshletVertices;
+	std::vector<uint8_t> m_MeshletTriangles;
+
+	Vector3 m_BoundsMin{};
+	Vector3 m_BoundsMax{};
+	Vector3 m_BoundingSphereCenter{};
+	float m_BoundingSphereRadius{};
+	bool m_IsCulled = false;
+
 	Matrix m_MatWorld{ Vector3::UnitX, Vector3::UnitY, Vector3::UnitZ, { 0.0f, 0.0f, 50.0f } };
 
 	BaseEffect* m_pEffect;
-	ID3D11InputLayout* m_pVertexLayout;
+	ID3D11InputLayout* m_pVertexLayout{};
 	ID3D11Buffer* m_pVertexBuffer;
 	ID3D11Buffer* m_pIndexBuffer;
 
 	int m_AmountIndices;
+
+	void CalculateBounds();
+	void BuildLods();
+	// appends the simplified levels to the index buffer, triangle lists only
+	void BuildLodLevels();
+	void BuildMeshlets();
+	void CalculateMeshletBounds(Meshlet& meshlet) const;
 };
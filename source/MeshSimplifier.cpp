@@ -0,0 +1,456 @@
+#include "pch.h"
+#include "MeshSimplifier.h"
+
+#include <queue>
+#include <unordered_map>
+
+namespace dae
+{
+	namespace
+	{
+		struct Quadric
+		{
+			// symmetric 4x4, only the upper triangle is stored
+			double a00{}, a01{}, a02{}, a03{};
+			double a11{}, a12{}, a13{};
+			double a22{}, a23{};
+			double a33{};
+
+			void AddPlane(double a, double b, double c, double d, double weight)
+			{
+				a00 += weight * a * a; a01 += weight * a * b; a02 += weight * a * c; a03 += weight * a * d;
+				a11 += weight * b * b; a12 += weight * b * c; a13 += weight * b * d;
+				a22 += weight * c * c; a23 += weight * c * d;
+				a33 += weight * d * d;
+			}
+
+			Quadric& operator+=(const Quadric& q)
+			{
+				a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+				a11 += q.a11; a12 += q.a12; a13 += q.a13;
+				a22 += q.a22; a23 += q.a23;
+				a33 += q.a33;
+				return *this;
+			}
+
+			double Evaluate(const Vector3& p) const
+			{
+				const double x = p.x, y = p.y, z = p.z;
+				return a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x
+					+ a11 * y * y + 2 * a12 * y * z + 2 * a13 * y
+					+ a22 * z * z + 2 * a23 * z
+					+ a33;
+			}
+		};
+
+		struct Collapse
+		{
+			double cost;
+			uint32_t from;
+			uint32_t to;
+			uint32_t fromVersion;
+			uint32_t toVersion;
+
+			bool operator>(const Collapse& other) const { return cost > other.cost; };
+		};
+
+		struct PositionKey
+		{
+			float x, y, z;
+
+			bool operator==(const PositionKey& other) const { return x == other.x && y == other.y && z == other.z; };
+		};
+
+		struct PositionKeyHash
+		{
+			size_t operator()(const PositionKey& key) const
+			{
+				const std::hash<float> hash{};
+				return hash(key.x) ^ (hash(key.y) * 31) ^ (hash(key.z) * 131);
+			}
+		};
+
+		// the attributes a vertex gets authored with, vertices with equal keys are interchangeable.
+		// tangents are left out, the obj loader accumulates them per face corner so they'd split every vertex
+		struct AttributeKey
+		{
+			float values[11];
+
+			explicit AttributeKey(const Mesh::Vertex_In& vertex)
+				: values{ vertex.position.x, vertex.position.y, vertex.position.z,
+					vertex.color.r, vertex.color.g, vertex.color.b,
+					vertex.uv.x, vertex.uv.y,
+					vertex.normal.x, vertex.normal.y, vertex.normal.z }
+			{
+			}
+
+			bool operator==(const AttributeKey& other) const { return std::equal(std::begin(values), std::end(values), std::begin(other.values)); };
+		};
+
+		struct AttributeKeyHash
+		{
+			size_t operator()(const AttributeKey& key) const
+			{
+				const std::hash<float> hash{};
+				size_t result{};
+
+				for (float value : key.values)
+				{
+					result = result * 31 + hash(value);
+				}
+
+				return result;
+			}
+		};
+
+		uint64_t EdgeKey(uint32_t a, uint32_t b)
+		{
+			return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+		}
+	}
+
+	std::vector<uint32_t> MeshSimplifier::Simplify(const std::vector<Mesh::Vertex_In>& vertices, const std::vector<uint32_t>& indices, size_t targetTriangleCount)
+	{
+		// weld vertices by position, the obj loader gives every face its own vertices
+		std::unordered_map<PositionKey, uint32_t, PositionKeyHash> welded;
+		std::vector<uint32_t> remap(vertices.size());
+		std::vector<Vector3> points;
+
+		for (uint32_t i = 0; i < vertices.size(); ++i)
+		{
+			const Vector3& position = vertices[i].position;
+			auto [it, inserted] = welded.try_emplace(PositionKey{ position.x, position.y, position.z }, static_cast<uint32_t>(points.size()));
+
+			if (inserted)
+			{
+				points.push_back(position);
+			}
+
+			remap[i] = it->second;
+		}
+
+		const size_t pointCount = points.size();
+		const size_t triangleCount = indices.size() / 3;
+
+		// and by every attribute, corners of one point in different classes lie on different sides of a seam
+		std::unordered_map<AttributeKey, uint32_t, AttributeKeyHash> attributeWelded;
+		std::vector<uint32_t> attributeClasses(vertices.size(), UINT32_MAX);
+
+		for (uint32_t index : indices)
+		{
+			attributeClasses[index] = attributeWelded.try_emplace(AttributeKey{ vertices[index] }, index).first->second;
+		}
+
+		// the vertex each corner currently uses, collapses hand the target's vertex to the moved corners
+		std::vector<uint32_t> cornerVertices = indices;
+
+		// a point collapsed into another one points at it, chains get followed when resolving
+		std::vector<uint32_t> collapsedInto(pointCount);
+		std::vector<uint32_t> versions(pointCount, 0);
+		std::vector<bool> isLocked(pointCount, false);
+		std::vector<Quadric> quadrics(pointCount);
+		std::vector<std::vector<uint32_t>> pointTriangles(pointCount);
+		std::vector<bool> isAlive(triangleCount, true);
+
+		for (uint32_t i = 0; i < pointCount; ++i)
+		{
+			collapsedInto[i] = i;
+		}
+
+		auto resolve = [&](uint32_t point)
+		{
+			while (collapsedInto[point] != point)
+			{
+				collapsedInto[point] = collapsedInto[collapsedInto[point]];
+				point = collapsedInto[point];
+			}
+
+			return point;
+		};
+
+		auto corner = [&](size_t triangle, int index)
+		{
+			return resolve(remap[indices[triangle * 3 + index]]);
+		};
+
+		// plane quadrics, area weighted & edge usage to find borders
+		std::unordered_map<uint64_t, int> edgeUsage;
+		size_t aliveTriangles = 0;
+
+		for (uint32_t t = 0; t < triangleCount; ++t)
+		{
+			const uint32_t p0 = corner(t, 0), p1 = corner(t, 1), p2 = corner(t, 2);
+
+			if (p0 == p1 || p1 == p2 || p2 == p0)
+			{
+				isAlive[t] = false;
+				continue;
+			}
+
+			++aliveTriangles;
+
+			Vector3 normal = Vector3::Cross(points[p1] - points[p0], points[p2] - points[p0]);
+			const float area = normal.Magnitude();
+
+			if (area > 0.f)
+			{
+				normal /= area;
+				const double d = -(normal * points[p0]);
+
+				for (uint32_t p : { p0, p1, p2 })
+				{
+					quadrics[p].AddPlane(normal.x, normal.y, normal.z, d, area);
+				}
+			}
+
+			for (uint32_t p : { p0, p1, p2 })
+			{
+				pointTriangles[p].push_back(t);
+			}
+
+			++edgeUsage[EdgeKey(p0, p1)];
+			++edgeUsage[EdgeKey(p1, p2)];
+			++edgeUsage[EdgeKey(p2, p0)];
+		}
+
+		// borders & non manifold edges stay where they are, collapsing them opens up holes
+		for (const auto& [edge, usage] : edgeUsage)
+		{
+			if (usage != 2)
+			{
+				isLocked[edge >> 32] = true;
+				isLocked[edge & 0xFFFFFFFF] = true;
+			}
+		}
+
+		std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> collapses;
+
+		auto pushCollapse = [&](uint32_t from, uint32_t to)
+		{
+			if (isLocked[from])
+			{
+				return;
+			}
+
+			Quadric quadric = quadrics[from];
+			quadric += quadrics[to];
+			collapses.push({ quadric.Evaluate(points[to]), from, to, versions[from], versions[to] });
+		};
+
+		for (const auto& [edge, usage] : edgeUsage)
+		{
+			const uint32_t a = static_cast<uint32_t>(edge >> 32);
+			const uint32_t b = static_cast<uint32_t>(edge & 0xFFFFFFFF);
+			pushCollapse(a, b);
+			pushCollapse(b, a);
+		}
+
+		while (aliveTriangles > targetTriangleCount && !collapses.empty())
+		{
+			const Collapse collapse = collapses.top();
+			collapses.pop();
+
+			// stale, one of the points changed since this got queued
+			if (resolve(collapse.from) != collapse.from || resolve(collapse.to) != collapse.to ||
+				versions[collapse.from] != collapse.fromVersion || versions[collapse.to] != collapse.toVersion)
+			{
+				continue;
+			}
+
+			// corners at from continue with the vertex their side of the collapsed edge uses at to.
+			// a seam point can only slide along its seam: each of its sides needs a triangle on the edge,
+			// otherwise a corner would end up with the uv & normal of another side
+			struct Side
+			{
+				uint32_t fromClass;
+				uint32_t toVertex;
+			};
+
+			Side sides[2]{};
+			int sideCount = 0;
+			bool isMapped = true;
+
+			auto findSide = [&](uint32_t fromClass)
+			{
+				for (int side = 0; side < sideCount; ++side)
+				{
+					if (sides[side].fromClass == fromClass)
+					{
+						return side;
+					}
+				}
+
+				return -1;
+			};
+
+			for (uint32_t t : pointTriangles[collapse.from])
+			{
+				for (int i = 0; i < 3 && isAlive[t]; ++i)
+				{
+					if (corner(t, i) != collapse.from)
+					{
+						continue;
+					}
+
+					for (int j = 0; j < 3; ++j)
+					{
+						if (corner(t, j) != collapse.to)
+						{
+							continue;
+						}
+
+						const uint32_t fromClass = attributeClasses[cornerVertices[t * 3 + i]];
+						const uint32_t toVertex = cornerVertices[t * 3 + j];
+						const int side = findSide(fromClass);
+
+						if (side < 0 && sideCount < 2)
+						{
+							sides[sideCount++] = { fromClass, toVertex };
+						}
+						else if (side < 0 || attributeClasses[sides[side].toVertex] != attributeClasses[toVertex])
+						{
+							isMapped = false;
+						}
+					}
+				}
+			}
+
+			for (uint32_t t : pointTriangles[collapse.from])
+			{
+				for (int i = 0; i < 3 && isAlive[t] && isMapped; ++i)
+				{
+					if (corner(t, i) == collapse.from && findSide(attributeClasses[cornerVertices[t * 3 + i]]) < 0)
+					{
+						isMapped = false;
+					}
+				}
+			}
+
+			if (!isMapped || sideCount == 0)
+			{
+				continue;
+			}
+
+			// reject collapses that would flip a remaining triangle
+			bool flips = false;
+
+			for (uint32_t t : pointTriangles[collapse.from])
+			{
+				if (!isAlive[t])
+				{
+					continue;
+				}
+
+				uint32_t p[3] = { corner(t, 0), corner(t, 1), corner(t, 2) };
+
+				if (p[0] == collapse.to || p[1] == collapse.to || p[2] == collapse.to)
+				{
+					continue;
+				}
+
+				const Vector3 oldNormal = Vector3::Cross(points[p[1]] - points[p[0]], points[p[2]] - points[p[0]]);
+
+				for (uint32_t& point : p)
+				{
+					if (point == collapse.from)
+					{
+						point = collapse.to;
+					}
+				}
+
+				const Vector3 newNormal = Vector3::Cross(points[p[1]] - points[p[0]], points[p[2]] - points[p[0]]);
+
+				if (oldNormal * newNormal <= 0.f)
+				{
+					flips = true;
+					break;
+				}
+			}
+
+			if (flips)
+			{
+				continue;
+			}
+
+			for (uint32_t t : pointTriangles[collapse.from])
+			{
+				for (int i = 0; i < 3 && isAlive[t]; ++i)
+				{
+					if (corner(t, i) == collapse.from)
+					{
+						cornerVertices[t * 3 + i] = sides[findSide(attributeClasses[cornerVertices[t * 3 + i]])].toVertex;
+					}
+				}
+			}
+
+			collapsedInto[collapse.from] = collapse.to;
+			quadrics[collapse.to] += quadrics[collapse.from];
+			++versions[collapse.from];
+			++versions[collapse.to];
+
+			for (uint32_t t : pointTriangles[collapse.from])
+			{
+				if (!isAlive[t])
+				{
+					continue;
+				}
+
+				const uint32_t p0 = corner(t, 0), p1 = corner(t, 1), p2 = corner(t, 2);
+
+				if (p0 == p1 || p1 == p2 || p2 == p0)
+				{
+					isAlive[t] = false;
+					--aliveTriangles;
+					continue;
+				}
+
+				pointTriangles[collapse.to].push_back(t);
+			}
+
+			pointTriangles[collapse.from].clear();
+
+			// costs around the surviving point changed
+			std::vector<uint32_t> neighbours;
+
+			for (uint32_t t : pointTriangles[collapse.to])
+			{
+				if (!isAlive[t])
+				{
+					continue;
+				}
+
+				for (int i = 0; i < 3; ++i)
+				{
+					const uint32_t p = corner(t, i);
+
+					if (p != collapse.to && std::find(neighbours.begin(), neighbours.end(), p) == neighbours.end())
+					{
+						neighbours.push_back(p);
+					}
+				}
+			}
+
+			for (uint32_t neighbour : neighbours)
+			{
+				pushCollapse(collapse.to, neighbour);
+				pushCollapse(neighbour, collapse.to);
+			}
+		}
+
+		// corners that never moved keep their own vertex (and its uv / normal), moved ones the one their chart uses at the target
+		std::vector<uint32_t> result;
+		result.reserve(aliveTriangles * 3);
+
+		for (uint32_t t = 0; t < triangleCount; ++t)
+		{
+			if (!isAlive[t])
+			{
+				continue;
+			}
+
+			result.insert(result.end(), cornerVertices.begin() + t * 3, cornerVertices.begin() + t * 3 + 3);
+		}
+
+		return result;
+	}
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "Mesh.h"
+
+namespace dae
+{
+	namespace MeshSimplifier
+	{
+		// quadric error driven half-edge collapses, vertices only ever move onto existing vertices
+		// so the result indexes the same vertex buffer as the input.
+		// vertices sharing a position are welded while simplifying, mesh borders & attribute seams
+		// (uv, normal or color differing at one position) are kept as is
+		std::vector<uint32_t> Simplify(const std::vector<Mesh::Vertex_In>& vertices, const std::vector<uint32_t>& indices, size_t targetTriangleCount);
+	}
+}
@@ -0,0 +1,321 @@
+#include "pch.h"
+#include "OcclusionBuffer.h"
+
+#include <cfloat>
+#include <emmintrin.h>
+
+namespace dae
+{
+	// bits [start, end) of a 32 pixel row
+	static uint32_t RowMask(int start, int end)
+	{
+		if (start >= end)
+		{
+			return 0;
+		}
+
+		const uint32_t endMask = end >= 32 ? UINT32_MAX : (1u << end) - 1;
+		return endMask & ~((1u << start) - 1);
+	}
+
+	OcclusionBuffer::OcclusionBuffer(int width, int height)
+		: m_Width((width + TileWidth - 1) / TileWidth * TileWidth)
+		, m_Height((height + TileHeight - 1) / TileHeight * TileHeight)
+	{
+		m_TilesX = m_Width / TileWidth;
+		m_TilesY = m_Height / TileHeight;
+
+		m_Tiles.resize(size_t(m_TilesX) * m_TilesY);
+		m_SpanStarts.resize(m_Height);
+		m_SpanEnds.resize(m_Height);
+	}
+
+	void OcclusionBuffer::BeginFrame(const Matrix& viewProjection, float nearPlane)
+	{
+		m_ViewProjection = viewProjection;
+		m_NearPlane = nearPlane;
+
+		// nothing covered, infinitely far away
+		std::fill(m_Tiles.begin(), m_Tiles.end(), Tile{});
+	}
+
+	void OcclusionBuffer::RenderOccluder(Mesh* pMesh, const Matrix& worldMatrix)
+	{
+		const Matrix worldViewProjection = worldMatrix * m_ViewProjection;
+
+		const auto& vertices = pMesh->GetVertices();
+		const auto& indices = pMesh->GetIndices();
+		const Mesh::Lod& lod = pMesh->GetLods()[pMesh->GetLod()];
+
+		const bool isStrip = pMesh->GetPrimitiveTopology() == Mesh::PrimitiveTopology::TriangleStrip;
+		const size_t first = isStrip ? 0 : lod.indexOffset;
+		const size_t step = isStrip ? 1 : 3;
+
+		// occluders use a coarse level of detail, transforming per corner is cheaper than the whole vertex buffer
+		for (size_t i = first; i + 2 < first + lod.indexCount; i += step)
+		{
+			const Vector3& p0 = vertices[indices[i]].position;
+			const Vector3& p1 = vertices[indices[i + 1]].position;
+			const Vector3& p2 = vertices[indices[i + 2]].position;
+
+			RenderTriangle(
+				worldViewProjection.TransformPoint({ p0.x, p0.y, p0.z, 1.f }),
+				worldViewProjection.TransformPoint({ p1.x, p1.y, p1.z, 1.f }),
+				worldViewProjection.TransformPoint({ p2.x, p2.y, p2.z, 1.f }));
+		}
+	}
+
+	void OcclusionBuffer::RenderTriangle(const Vector4& v0, const Vector4& v1, const Vector4& v2)
+	{
+		// no clipping, leaving a triangle out only ever makes the buffer more conservative
+		if (v0.w < m_NearPlane || v1.w < m_NearPlane || v2.w < m_NearPlane)
+		{
+			return;
+		}
+
+		// screen space with pixel centers at +0.5, depth as 1 / w
+		const Vector3 s0{ (v0.x / v0.w * 0.5f + 0.5f) * m_Width, (0.5f - v0.y / v0.w * 0.5f) * m_Height, 1.f / v0.w };
+		const Vector3 s1{ (v1.x / v1.w * 0.5f + 0.5f) * m_Width, (0.5f - v1.y / v1.w * 0.5f) * m_Height, 1.f / v1.w };
+		const Vector3 s2{ (v2.x / v2.w * 0.5f + 0.5f) * m_Width, (0.5f - v2.y / v2.w * 0.5f) * m_Height, 1.f / v2.w };
+
+		const float area = (s1.x - s0.x) * (s2.y - s0.y) - (s2.x - s0.x) * (s1.y - s0.y);
+
+		if (area == 0.f)
+		{
+			return;
+		}
+
+		const int firstRow = std::max(static_cast<int>(ceilf(std::min({ s0.y, s1.y, s2.y }) - 0.5f)), 0);
+		const int lastRow = std::min(static_cast<int>(floorf(std::max({ s0.y, s1.y, s2.y }) - 0.5f)), m_Height - 1);
+		const int firstColumn = std::max(static_cast<int>(ceilf(std::min({ s0.x, s1.x, s2.x }) - 0.5f)), 0);
+		const int lastColumn = std::min(static_cast<int>(floorf(std::max({ s0.x, s1.x, s2.x }) - 0.5f)), m_Width - 1);
+
+		if (firstRow > lastRow || firstColumn > lastColumn)
+		{
+			return;
+		}
+
+		// per edge a * (x - origin.x) + b * (y - origin.y) >= 0 inside, for both windings.
+		// on a row that's one bound on x, so every row is a single span: 4 rows at a time
+		const Vector3* pOrigins[3]{ &s0, &s1, &s2 };
+		const float sign = area > 0.f ? 1.f : -1.f;
+		const float edgeA[3]{ (s0.y - s1.y) * sign, (s1.y - s2.y) * sign, (s2.y - s0.y) * sign };
+		const float edgeB[3]{ (s1.x - s0.x) * sign, (s2.x - s1.x) * sign, (s0.x - s2.x) * sign };
+
+		const __m128 rowOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+
+		for (int row{ firstRow }; row <= lastRow; row += 4)
+		{
+			const __m128 y = _mm_add_ps(_mm_set1_ps(static_cast<float>(row)), rowOffsets);
+			__m128 low = _mm_set1_ps(-FLT_MAX);
+			__m128 high = _mm_set1_ps(FLT_MAX);
+
+			for (int edge{}; edge < 3; ++edge)
+			{
+				const __m128 dy = _mm_sub_ps(y, _mm_set1_ps(pOrigins[edge]->y));
+
+				if (edgeA[edge] == 0.f)
+				{
+					// horizontal edge, whole rows are either inside or outside
+					const __m128 outside = _mm_cmplt_ps(_mm_mul_ps(_mm_set1_ps(edgeB[edge]), dy), _mm_setzero_ps());
+					low = _mm_or_ps(_mm_andnot_ps(outside, low), _mm_and_ps(outside, _mm_set1_ps(FLT_MAX)));
+					continue;
+				}
+
+				// where the edge crosses the row
+				const __m128 x = _mm_sub_ps(_mm_set1_ps(pOrigins[edge]->x), _mm_div_ps(_mm_mul_ps(_mm_set1_ps(edgeB[edge]), dy), _mm_set1_ps(edgeA[edge])));
+
+				if (edgeA[edge] > 0.f)
+				{
+					low = _mm_max_ps(low, x);
+				}
+				else
+				{
+					high = _mm_min_ps(high, x);
+				}
+			}
+
+			alignas(16) float lows[4];
+			alignas(16) float highs[4];
+			_mm_store_ps(lows, low);
+			_mm_store_ps(highs, high);
+
+			for (int lane{}; lane < 4 && row + lane <= lastRow; ++lane)
+			{
+				// pixel centers inside [low, high], clamped first so empty rows don't overflow the conversion
+				const float spanLow = std::clamp(lows[lane], -1.f, float(m_Width + 1));
+				const float spanHigh = std::clamp(highs[lane], -1.f, float(m_Width + 1));
+
+				m_SpanStarts[row + lane] = std::max(static_cast<int>(ceilf(spanLow - 0.5f)), firstColumn);
+				m_SpanEnds[row + lane] = std::min(static_cast<int>(floorf(spanHigh - 0.5f)) + 1, lastColumn + 1);
+			}
+		}
+
+		// 1 / w is a plane in screen space
+		const float dzdx = ((s1.z - s0.z) * (s2.y - s0.y) - (s2.z - s0.z) * (s1.y - s0.y)) / area;
+		const float dzdy = ((s2.z - s0.z) * (s1.x - s0.x) - (s1.z - s0.z) * (s2.x - s0.x)) / area;
+		const float zMinVertex = std::min({ s0.z, s1.z, s2.z });
+
+		for (int tileY{ firstRow / TileHeight }; tileY <= lastRow / TileHeight; ++tileY)
+		{
+			const int top = std::max(tileY * TileHeight, firstRow);
+			const int bottom = std::min(tileY * TileHeight + TileHeight - 1, lastRow);
+
+			for (int tileX{ firstColumn / TileWidth }; tileX <= lastColumn / TileWidth; ++tileX)
+			{
+				const int tileLeft = tileX * TileWidth;
+				uint32_t coverage[TileHeight]{};
+				bool isCovered = false;
+
+				for (int row{ top }; row <= bottom; ++row)
+				{
+					const int start = std::max(m_SpanStarts[row] - tileLeft, 0);
+					const int end = std::min(m_SpanEnds[row] - tileLeft, TileWidth);
+
+					coverage[row - tileY * TileHeight] = RowMask(start, end);
+					isCovered |= start < end;
+				}
+
+				if (!isCovered)
+				{
+					continue;
+				}
+
+				// farthest the triangle gets within the covered part of the tile: the plane's minimum over the corners
+				// of the pixel centers it spans, never farther than its farthest vertex
+				const float left = std::max(tileLeft, firstColumn) + 0.5f - s0.x;
+				const float right = std::min(tileLeft + TileWidth - 1, lastColumn) + 0.5f - s0.x;
+				const float zLeft = std::min(dzdx * left, dzdx * right);
+				const float zTop = std::min(dzdy * (top + 0.5f - s0.y), dzdy * (bottom + 0.5f - s0.y));
+
+				UpdateTile(m_Tiles[tileX + tileY * m_TilesX], coverage, std::max(s0.z + zLeft + zTop, zMinVertex));
+			}
+		}
+	}
+
+	void OcclusionBuffer::UpdateTile(Tile& tile, const uint32_t* pCoverage, float zMin) const
+	{
+		// not in front of what the whole tile already has
+		if (zMin <= tile.zMin[0])
+		{
+			return;
+		}
+
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i coverage = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pCoverage));
+		__m128i mask = _mm_load_si128(reinterpret_cast<const __m128i*>(tile.mask));
+
+		const bool hasWorkingLayer = _mm_movemask_epi8(_mm_cmpeq_epi32(mask, zero)) != 0xFFFF;
+
+		// a triangle much closer than the working layer starts a new one, merging would lose most of its depth
+		if (!hasWorkingLayer || zMin - tile.zMin[1] > tile.zMin[1] - tile.zMin[0])
+		{
+			mask = zero;
+			tile.zMin[1] = zMin;
+		}
+		else
+		{
+			tile.zMin[1] = std::min(tile.zMin[1], zMin);
+		}
+
+		mask = _mm_or_si128(mask, coverage);
+
+		// the working layer covers the whole tile, it becomes the tile's depth
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(mask, _mm_set1_epi32(-1))) == 0xFFFF)
+		{
+			tile.zMin[0] = tile.zMin[1];
+			mask = zero;
+		}
+
+		_mm_store_si128(reinterpret_cast<__m128i*>(tile.mask), mask);
+	}
+
+	bool OcclusionBuffer::IsBoxVisible(const Vector3& boxMin, const Vector3& boxMax, const Matrix& worldMatrix) const
+	{
+		const Matrix worldViewProjection = worldMatrix * m_ViewProjection;
+
+		float left = FLT_MAX, top = FLT_MAX, right = -FLT_MAX, bottom = -FLT_MAX;
+		float zMax = 0.f;
+
+		for (int corner{}; corner < 8; ++corner)
+		{
+			const Vector4 clip = worldViewProjection.TransformPoint(
+				corner & 1 ? boxMax.x : boxMin.x,
+				corner & 2 ? boxMax.y : boxMin.y,
+				corner & 4 ? boxMax.z : boxMin.z,
+				1.f);
+
+			if (clip.w < m_NearPlane)
+			{
+				return true;
+			}
+
+			const float x = (clip.x / clip.w * 0.5f + 0.5f) * m_Width;
+			const float y = (0.5f - clip.y / clip.w * 0.5f) * m_Height;
+
+			left = std::min(left, x);
+			right = std::max(right, x);
+			top = std::min(top, y);
+			bottom = std::max(bottom, y);
+			zMax = std::max(zMax, 1.f / clip.w);
+		}
+
+		// every pixel the projected box touches
+		const int firstColumn = std::max(static_cast<int>(floorf(left)), 0);
+		const int lastColumn = std::min(static_cast<int>(floorf(right)), m_Width - 1);
+		const int firstRow = std::max(static_cast<int>(floorf(top)), 0);
+		const int lastRow = std::min(static_cast<int>(floorf(bottom)), m_Height - 1);
+
+		if (firstColumn > lastColumn || firstRow > lastRow)
+		{
+			return true;
+		}
+
+		return IsRectVisible(firstColumn, firstRow, lastColumn, lastRow, zMax);
+	}
+
+	bool OcclusionBuffer::IsSphereVisible(const Vector3& center, float radius, const Matrix& worldMatrix) const
+	{
+		const Vector3 extent{ radius, radius, radius };
+		return IsBoxVisible(center - extent, center + extent, worldMatrix);
+	}
+
+	bool OcclusionBuffer::IsRectVisible(int left, int top, int right, int bottom, float zMax) const
+	{
+		const __m128i zero = _mm_setzero_si128();
+
+		for (int tileY{ top / TileHeight }; tileY <= bottom / TileHeight; ++tileY)
+		{
+			const int firstRow = std::max(top - tileY * TileHeight, 0);
+			const int lastRow = std::min(bottom - tileY * TileHeight, TileHeight - 1);
+
+			for (int tileX{ left / TileWidth }; tileX <= right / TileWidth; ++tileX)
+			{
+				const Tile& tile = m_Tiles[tileX + tileY * m_TilesX];
+
+				// the rect's pixels in this tile
+				const uint32_t rowMask = RowMask(std::max(left - tileX * TileWidth, 0), std::min(right - tileX * TileWidth + 1, TileWidth));
+				alignas(16) uint32_t rows[TileHeight]{};
+
+				for (int row{ firstRow }; row <= lastRow; ++row)
+				{
+					rows[row] = rowMask;
+				}
+
+				const __m128i rect = _mm_load_si128(reinterpret_cast<const __m128i*>(rows));
+				const __m128i mask = _mm_load_si128(reinterpret_cast<const __m128i*>(tile.mask));
+
+				// pixels outside the working layer are only as close as the whole tile, the ones inside as the layer
+				const bool hasTilePixels = _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_andnot_si128(mask, rect), zero)) != 0xFFFF;
+				const bool hasLayerPixels = _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(mask, rect), zero)) != 0xFFFF;
+
+				if ((hasTilePixels && zMax >= tile.zMin[0]) || (hasLayerPixels && zMax >= tile.zMin[1]))
+				{
+					return true;
+				}
+			}
+		}
+
+		return false;
+	}
+}
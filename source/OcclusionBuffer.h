@@ -0,0 +1,64 @@
+#pragma once
+#include <vector>
+#include "Mesh.h"
+
+namespace dae
+{
+	// low resolution masked occlusion buffer: instead of a depth per pixel, every tile of 32 x 4 pixels keeps
+	// a coverage mask & two depth layers. a few big occluders get rasterized into it each frame,
+	// bounds of meshes, instances & meshlets get tested against it before any of their vertices are touched.
+	// depth is 1 / w, so it interpolates linearly in screen space & greater is closer
+	class OcclusionBuffer final
+	{
+	public:
+		static constexpr int TileWidth = 32;
+		static constexpr int TileHeight = 4;
+
+		// sized in tiles, covering the whole window at a lower resolution
+		OcclusionBuffer(int width, int height);
+
+		OcclusionBuffer(const OcclusionBuffer&) = delete;
+		OcclusionBuffer(OcclusionBuffer&&) noexcept = delete;
+		OcclusionBuffer& operator=(const OcclusionBuffer&) = delete;
+		OcclusionBuffer& operator=(OcclusionBuffer&&) noexcept = delete;
+
+		// clears every tile, occluders & tests look through viewProjection until the next BeginFrame
+		void BeginFrame(const Matrix& viewProjection, float nearPlane);
+
+		// the mesh's current level of detail, both windings. triangles crossing the near plane are skipped
+		void RenderOccluder(Mesh* pMesh, const Matrix& worldMatrix);
+
+		// conservative: anything reaching past the near plane or off screen counts as visible
+		bool IsBoxVisible(const Vector3& boxMin, const Vector3& boxMax, const Matrix& worldMatrix) const;
+		bool IsSphereVisible(const Vector3& center, float radius, const Matrix& worldMatrix) const;
+
+		int GetWidth() const { return m_Width; };
+		int GetHeight() const { return m_Height; };
+
+	private:
+		struct alignas(16) Tile
+		{
+			// one row of 32 pixels per lane, pixels in the mask belong to the working layer
+			uint32_t mask[TileHeight]{};
+			// farthest depth of the whole tile, and of the pixels in the mask
+			float zMin[2]{};
+		};
+
+		int m_Width{};
+		int m_Height{};
+		int m_TilesX{};
+		int m_TilesY{};
+
+		Matrix m_ViewProjection{};
+		float m_NearPlane{};
+
+		std::vector<Tile> m_Tiles;
+		// covered columns [start, end) per row of the triangle being rasterized
+		std::vector<int> m_SpanStarts;
+		std::vector<int> m_SpanEnds;
+
+		void RenderTriangle(const Vector4& v0, const Vector4& v1, const Vector4& v2);
+		void UpdateTile(Tile& tile, const uint32_t* pCoverage, float zMin) const;
+		bool IsRectVisible(int left, int top, int right, int bottom, float zMax) const;
+	};
+}
@@ -2,6 +2,7 @@
 #include "Renderer.h"
 #include "Effect.h"
 #include "TransparentEffect.h"
+#include "Frustum.h"
 
 namespace dae {
 
@@ -16,16 +17,85 @@ namespace dae {
 		m_pHardware = new HardwareRenderer(pWindow, m_pCamera);
 		m_pSoftware = new SoftwareRenderer(pWindow, m_pCamera);
 
-		// Initialize meshes
-		auto vehicleEffect = new Effect(m_pHardware->GetDevice());
-		auto vehicleMesh = new Mesh(m_pHardware->GetDevice(), vehicleEffect, "Resources/vehicle.obj");
+		// half the window's resolution, shared by both backends
+		m_pOcclusion = new OcclusionBuffer(m_Width / 2, m_Height / 2);
+		m_pSoftware->SetOcclusionBuffer(m_pOcclusion);
+		m_pSoftware->SetLodScreenRadius(m_LodScreenRadius);
 
-		m_pSoftware->SetTextures(vehicleEffect->GetTexture(), vehicleEffect->GetNormal(), vehicleEffect->GetGloss(), vehicleEffect->GetSpecular());
-		m_pMeshes.push_back(vehicleMesh);
+		// Initialize meshes, every file starts loading before the effects compile. nothing gets joined until the first frame
+		m_pAssets = new AssetLoader(m_pHardware->GetDevice());
 
-		auto transEffect = new TransparentEffect(m_pHardware->GetDevice());
-		auto fireMesh = new Mesh(m_pHardware->GetDevice(), transEffect, "Resources/fireFX.obj");
-		m_pMeshes.push_back(fireMesh);
+		// the software sampler reads block compressed copies, only the channels the shaders use are kept
+		const auto vehicleDiffuse = m_pAssets->LoadTexture("Resources/vehicle_diffuse.png", TextureFormat::BC1);
+		const auto vehicleNormal = m_pAssets->LoadTexture("Resources/vehicle_normal.png", TextureFormat::BC5);
+		const auto vehicleSpecular = m_pAssets->LoadTexture("Resources/vehicle_specular.png", TextureFormat::BC1);
+		const auto vehicleGloss = m_pAssets->LoadTexture("Resources/vehicle_gloss.png", TextureFormat::BC4);
+		const auto fireDiffuse = m_pAssets->LoadTexture("Resources/fireFX_diffuse.png", TextureFormat::BC3);
+
+		m_pVehicleEffect = new Effect(m_pHardware->GetDevice(), vehicleDiffuse, vehicleNormal, vehicleSpecular, vehicleGloss);
+		m_VehicleLoad = m_pAssets->LoadMesh(m_pVehicleEffect, "Resources/vehicle.obj");
+
+		m_pFireEffect = new TransparentEffect(m_pHardware->GetDevice(), fireDiffuse);
+		m_FireLoad = m_pAssets->LoadMesh(m_pFireEffect, "Resources/fireFX.obj");
+
+		// 32 x 32 parking spots, rows going away from the camera
+		const int rows = 32;
+		const int columns = 32;
+
+		for (int row = 0; row < rows; ++row)
+		{
+			for (int column = 0; column < columns; ++column)
+			{
+				m_InstanceOffsets.push_back({ (column - columns / 2) * 60.f, 0.f, row * 120.f });
+
+				SoftwareRenderer::Instance instance{};
+				instance.tint = { 0.6f + 0.4f * ((row + column) % 3 == 0), 0.6f + 0.4f * ((row + column) % 3 == 1), 0.6f + 0.4f * ((row + column) % 3 == 2) };
+				m_Instances.push_back(instance);
+			}
+		}
+
+		// a ring of colored point lights around the vehicle
+		const Vector3 vehicleCenter{ 0.f, 0.f, 50.f };
+		const int ringLights = 24;
+
+		for (int i = 0; i < ringLights; ++i)
+		{
+			const float angle = i * (PI_2 / ringLights);
+
+			Light light{};
+			light.position = vehicleCenter + Vector3{ cosf(angle) * 35.f, 10.f, sinf(angle) * 35.f };
+			light.color = { 0.5f + 0.5f * cosf(angle), 0.5f + 0.5f * cosf(angle + PI_2 / 3.f), 0.5f + 0.5f * cosf(angle - PI_2 / 3.f) };
+			light.intensity = 0.5f;
+			light.range = 30.f;
+			m_Lights.push_back(light);
+		}
+
+		// one over every 4 x 4 parking spots
+		for (int row = 0; row < rows; row += 4)
+		{
+			for (int column = 0; column < columns; column += 4)
+			{
+				Light light{};
+				light.position = vehicleCenter + Vector3{ (column - columns / 2) * 60.f + 90.f, 40.f, row * 120.f + 180.f };
+				light.color = { 1.f, 0.85f, 0.6f };
+				light.intensity = 0.4f;
+				light.range = 200.f;
+				m_Lights.push_back(light);
+			}
+		}
+
+		// two spots on the vehicle from the front corners
+		for (float side : { -1.f, 1.f })
+		{
+			Light light{};
+			light.type = Light::Type::Spot;
+			light.position = vehicleCenter + Vector3{ side * 40.f, 30.f, -40.f };
+			light.direction = (vehicleCenter - light.position).Normalized();
+			light.color = { 0.7f, 0.8f, 1.f };
+			light.intensity = 1.f;
+			light.range = 100.f;
+			m_Lights.push_back(light);
+		}
 
 		// print keybinds (coloring was weird but eh)
 		// https://stackoverflow.com/questions/4053837/colorizing-text-in-the-console-with-c
@@ -35,7 +105,8 @@ namespace dae {
 		std::cout << "  [F2]  Toggle Vehicle Rotation\n";
 		std::cout << "  [F9]  Cycle CullMode\n";
 		std::cout << "  [F10] Toggle Uniform ClearColor\n";
-		std::cout << "  [F11] Toggle Print FPS (ON / OFF)\n\n";
+		std::cout << "  [F11] Toggle Print FPS (ON / OFF)\n";
+		std::cout << "  [H]   Toggle Occlusion Culling\n\n";
 
 		std::cout << "\x1B[32m";
 		std::cout << "HARDWARE KEY BINDINGS\n";
@@ -48,6 +119,22 @@ namespace dae {
 		std::cout << "  [F6] Toggle NormalMap\n";
 		std::cout << "  [F7] Toggle DepthBuffer Visualization\n";
 		std::cout << "  [F8] Toggle BoundingBox Visualization\n";
+		std::cout << "  [1]  Cycle Depth Format\n";
+		std::cout << "  [2]  Toggle Pipelined Frames\n";
+		std::cout << "  [3]  Toggle Async Output\n";
+		std::cout << "  [4]  Toggle Meshlet Culling\n";
+		std::cout << "  [5]  Toggle Instanced Parking Lot\n";
+		std::cout << "  [6]  Toggle Dynamic Resolution\n";
+		std::cout << "  [7]  Cycle Shading Rate\n";
+		std::cout << "  [8]  Toggle 4x MSAA\n";
+		std::cout << "  [9]  Toggle Dirty Tracking\n";
+		std::cout << "  [0]  Toggle Per-Vertex Tangent Space\n";
+		std::cout << "  [P]  Toggle Fast Shading Math\n";
+		std::cout << "  [O]  Cycle Software Shader\n";
+		std::cout << "  [L]  Toggle Light Rig\n";
+		std::cout << "  [K]  Cycle Shadows\n";
+		std::cout << "  [J]  Toggle Depth Prepass\n";
+		std::cout << "  [I]  Toggle Overdraw Counter\n";
 		std::cout << "\n\n";
 
 		std::cout << "\x1B[37m";
@@ -55,20 +142,53 @@ namespace dae {
 
 	Renderer::~Renderer()
 	{
+		// takes ownership of whatever is still loading
+		FinishLoading();
+
 		delete m_pCamera;
 		delete m_pHardware;
 		delete m_pSoftware;
+		delete m_pOcclusion;
 
 		for (size_t i = 0; i < m_pMeshes.size(); i++)
 		{
 			delete m_pMeshes[i];
 		}
+
+		delete m_pAssets;
+	}
+
+	void Renderer::FinishLoading()
+	{
+		if (m_IsLoaded)
+		{
+			return;
+		}
+
+		Mesh* pVehicleMesh = m_VehicleLoad.Get();
+		Mesh* pFireMesh = m_FireLoad.Get();
+
+		m_pVehicleEffect->FinishLoading();
+		m_pFireEffect->FinishLoading();
+
+		m_pSoftware->SetTextures(m_pVehicleEffect->GetTexture(), m_pVehicleEffect->GetNormal(), m_pVehicleEffect->GetGloss(), m_pVehicleEffect->GetSpecular());
+		m_pSoftware->SetShaderProgram(m_pVehicleEffect->GetSoftwareShader());
+		m_pMeshes.push_back(pVehicleMesh);
+		m_pOccluders.push_back(pVehicleMesh);
+		m_pMeshes.push_back(pFireMesh);
+
+		m_IsLoaded = true;
 	}
 
 	void Renderer::Update(const Timer* pTimer)
 	{
 		m_pCamera->Update(pTimer);
 
+		if (m_RenderMode == RenderMode::Software)
+		{
+			m_pSoftware->UpdateResolutionScale(pTimer);
+		}
+
 		if (m_RotateMesh)
 		{
 			for (size_t i = 0; i < m_pMeshes.size(); i++)
@@ -78,11 +198,31 @@ namespace dae {
 		}
 	}
 
-	void Renderer::Render() const
+	void Renderer::Render()
 	{
+		FinishLoading();
+
+		CullMeshes();
+		SelectLods();
+		UpdateInstances();
+
+		// occluders go in at the level of detail they get rendered with
+		if (m_UseOcclusionCulling)
+		{
+			RenderOccluders();
+			CullOccludedMeshes();
+		}
+
 		if (m_RenderMode == RenderMode::Software)
 		{
-			m_pSoftware->Render(m_pMeshes);
+			if (m_UseInstancing)
+			{
+				m_pSoftware->RenderInstanced(m_pMeshes[0], m_Instances);
+			}
+			else
+			{
+				m_pSoftware->Render(m_pMeshes);
+			}
 		}
 		else
 		{
@@ -90,10 +230,159 @@ namespace dae {
 		}
 	}
 
+	void Renderer::CullMeshes()
+	{
+		m_CulledMeshCount = 0;
+		m_OccludedMeshCount = 0;
+		const Matrix viewProjection = m_pCamera->viewMatrix * m_pCamera->projectionMatrix;
+
+		for (Mesh* pMesh : m_pMeshes)
+		{
+			// frustum in object space, so the bounds don't need transforming
+			const Frustum frustum{ pMesh->GetWorldMatrix() * viewProjection };
+
+			const bool isCulled = !frustum.IsSphereVisible(pMesh->GetBoundingSphereCenter(), pMesh->GetBoundingSphereRadius()) ||
+				!frustum.IsBoxVisible(pMesh->GetBoundsMin(), pMesh->GetBoundsMax());
+
+			pMesh->SetCulled(isCulled);
+
+			if (isCulled)
+			{
+				++m_CulledMeshCount;
+			}
+		}
+	}
+
+	void Renderer::UpdateInstances()
+	{
+		if (m_RenderMode != RenderMode::Software || !m_UseInstancing)
+		{
+			return;
+		}
+
+		// every copy follows the vehicle's rotation around its own center
+		const Matrix world = m_pMeshes[0]->GetWorldMatrix();
+
+		for (size_t i = 0; i < m_Instances.size(); ++i)
+		{
+			m_Instances[i].worldMatrix = world * Matrix::CreateTranslation(m_InstanceOffsets[i]);
+		}
+	}
+
+	void Renderer::RenderOccluders()
+	{
+		m_pOcclusion->BeginFrame(m_pCamera->viewMatrix * m_pCamera->projectionMatrix, m_pCamera->nearPlane);
+
+		if (m_RenderMode != RenderMode::Software || !m_UseInstancing)
+		{
+			for (Mesh* pMesh : m_pOccluders)
+			{
+				if (!pMesh->IsCulled())
+				{
+					m_pOcclusion->RenderOccluder(pMesh, pMesh->GetWorldMatrix());
+				}
+			}
+
+			return;
+		}
+
+		// the parking lot copies closest to the camera, among the ones in view
+		Mesh* pMesh = m_pMeshes[0];
+		const Frustum frustum{ m_pCamera->viewMatrix * m_pCamera->projectionMatrix };
+		std::vector<std::pair<float, size_t>> candidates;
+
+		for (size_t i = 0; i < m_Instances.size(); ++i)
+		{
+			const Vector3 center = m_Instances[i].worldMatrix.TransformPoint(pMesh->GetBoundingSphereCenter());
+
+			if (frustum.IsSphereVisible(center, pMesh->GetBoundingSphereRadius()))
+			{
+				candidates.push_back({ (center - m_pCamera->origin).SqrMagnitude(), i });
+			}
+		}
+
+		const size_t occluderCount = std::min(candidates.size(), OccluderInstanceCount);
+		std::partial_sort(candidates.begin(), candidates.begin() + occluderCount, candidates.end());
+
+		for (size_t i = 0; i < occluderCount; ++i)
+		{
+			m_pOcclusion->RenderOccluder(pMesh, m_Instances[candidates[i].second].worldMatrix);
+		}
+	}
+
+	void Renderer::CullOccludedMeshes()
+	{
+		for (Mesh* pMesh : m_pMeshes)
+		{
+			// occluders would only ever find themselves in front
+			if (pMesh->IsCulled() || std::find(m_pOccluders.begin(), m_pOccluders.end(), pMesh) != m_pOccluders.end())
+			{
+				continue;
+			}
+
+			if (!m_pOcclusion->IsBoxVisible(pMesh->GetBoundsMin(), pMesh->GetBoundsMax(), pMesh->GetWorldMatrix()))
+			{
+				pMesh->SetCulled(true);
+				++m_OccludedMeshCount;
+			}
+		}
+	}
+
+	void Renderer::SelectLods()
+	{
+		// pixels covered by one world unit at distance 1
+		const float pixelsPerUnit = m_Height * 0.5f / m_pCamera->fov;
+
+		for (Mesh* pMesh : m_pMeshes)
+		{
+			if (pMesh->IsCulled())
+			{
+				continue;
+			}
+
+			const Matrix world = pMesh->GetWorldMatrix();
+			const Vector3 center = world.TransformPoint(pMesh->GetBoundingSphereCenter());
+			const float scale = std::max(std::max(world.GetAxisX().Magnitude(), world.GetAxisY().Magnitude()), world.GetAxisZ().Magnitude());
+			const float distance = std::max((center - m_pCamera->origin).Magnitude(), m_pCamera->nearPlane);
+
+			const float screenRadius = pMesh->GetBoundingSphereRadius() * scale * pixelsPerUnit / distance;
+
+			pMesh->SetLod(pMesh->SelectLod(screenRadius, m_LodScreenRadius));
+		}
+	}
+
+	void Renderer::ToggleInstancing()
+	{
+		m_UseInstancing = !m_UseInstancing;
+		auto text = m_UseInstancing ? "On" : "Off";
+		std::cout << "Toggled Instanced Parking Lot " << text << "\n";
+	}
+
+	void Renderer::ToggleLights()
+	{
+		m_UseLights = !m_UseLights;
+		m_pSoftware->SetLights(m_UseLights ? m_Lights : std::vector<Light>{});
+
+		auto text = m_UseLights ? "On" : "Off";
+		std::cout << "Toggled Light Rig " << text << " (" << (m_UseLights ? m_Lights.size() : 0) << " lights)\n";
+	}
+
+	void Renderer::ToggleOcclusionCulling()
+	{
+		m_UseOcclusionCulling = !m_UseOcclusionCulling;
+		m_pSoftware->SetOcclusionBuffer(m_UseOcclusionCulling ? m_pOcclusion : nullptr);
+
+		auto text = m_UseOcclusionCulling ? "On" : "Off";
+		std::cout << "Toggled Occlusion Culling " << text << "\n";
+	}
+
 	void Renderer::ToggleRasterizerMode()
 	{
 		m_RenderMode = (RenderMode)(((int)m_RenderMode + 1) % (int)RenderMode::END);
 
+		// DirectX presented on top of the software output in the meantime
+		m_pSoftware->InvalidateFrame();
+
 		m_pCamera->angleVelocity = (int)m_RenderMode ? 3.5f : 0.25f;
 		auto text = (int)m_RenderMode ? "DirectX" : "Software";
 		std::cout << "Toggled Rasterization Mode: " << text << "\n";
@@ -108,11 +397,13 @@ namespace dae {
 
 	void Renderer::CycleSampleState()
 	{
+		FinishLoading();
 		m_pHardware->CycleSampleState(m_pMeshes);
 	}
 
 	void Renderer::CycleCullingMode()
 	{
+		FinishLoading();
 		m_CullMode = (Mesh::CullMode)(((int)m_CullMode + 1) % (int)Mesh::CullMode::END);
 		
 		auto text = "Back";
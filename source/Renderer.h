@@ -3,6 +3,8 @@
 #include "HardwareRenderer.h"
 #include "SoftwareRenderer.h"
 #include "Mesh.h"
+#include "OcclusionBuffer.h"
+#include "AssetLoader.h"
 
 struct SDL_Window;
 struct SDL_Surface;
@@ -28,7 +30,7 @@ namespace dae
 		Renderer& operator=(Renderer&&) noexcept = delete;
 
 		void Update(const Timer* pTimer);
-		void Render() const;
+		void Render();
 
 		RenderMode GetRenderMode() { return m_RenderMode; };
 		HardwareRenderer* GetHardwareRenderer() { return m_pHardware; };
@@ -39,6 +41,18 @@ namespace dae
 		void CycleSampleState();
 		void CycleCullingMode();
 		void ToggleUniformColor();
+		void ToggleInstancing();
+		void ToggleLights();
+		void ToggleOcclusionCulling();
+
+		// the next frame gets rendered in full, even if nothing changed
+		void InvalidateFrame() { m_pSoftware->InvalidateFrame(); };
+		// nothing changed since the last frame, there was nothing to render
+		bool IsIdle() const { return m_RenderMode == RenderMode::Software && m_pSoftware->IsIdle(); };
+
+		size_t GetMeshCount() const { return m_pMeshes.size(); };
+		size_t GetCulledMeshCount() const { return m_CulledMeshCount; };
+		size_t GetOccludedMeshCount() const { return m_OccludedMeshCount; };
 
 	private:
 		dae::Camera* m_pCamera;
@@ -48,6 +62,26 @@ namespace dae
 
 		std::vector<Mesh*> m_pMeshes;
 
+		// started by the constructor, the first Render joins them & adds the meshes
+		dae::AssetLoader* m_pAssets;
+		AssetFuture<Mesh*> m_VehicleLoad;
+		AssetFuture<Mesh*> m_FireLoad;
+		BaseEffect* m_pVehicleEffect;
+		BaseEffect* m_pFireEffect;
+		bool m_IsLoaded = false;
+		size_t m_CulledMeshCount{};
+
+		// opaque meshes big enough to hide others, rendered into the occlusion buffer before anything gets tested
+		bool m_UseOcclusionCulling = true;
+		dae::OcclusionBuffer* m_pOcclusion;
+		std::vector<Mesh*> m_pOccluders;
+		size_t m_OccludedMeshCount{};
+		// closest parking lot copies that occlude the rest
+		static constexpr size_t OccluderInstanceCount = 8;
+
+		// projected bounding sphere radius in pixels below which the next level of detail gets used, halves per level
+		float m_LodScreenRadius{ 200.f };
+
 		RenderMode m_RenderMode = RenderMode::Hardware;
 		Mesh::CullMode m_CullMode = Mesh::CullMode::Back;
 
@@ -56,5 +90,21 @@ namespace dae
 
 		bool m_RotateMesh;
 		bool m_UseUniformColor;
+
+		// parking lot of vehicle copies around the vehicle, software only
+		bool m_UseInstancing = false;
+		std::vector<SoftwareRenderer::Instance> m_Instances;
+		std::vector<Vector3> m_InstanceOffsets;
+
+		// point lights around the vehicle & over the parking lot plus two spots, software only
+		bool m_UseLights = false;
+		std::vector<Light> m_Lights;
+
+		void FinishLoading();
+		void CullMeshes();
+		void UpdateInstances();
+		void RenderOccluders();
+		void CullOccludedMeshes();
+		void SelectLods();
 	};
 }
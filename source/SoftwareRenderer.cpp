@@ -7,104 +7,333 @@
 #include "SoftwareRenderer.h"
 #include <iostream>
 #include "Mesh.h"
+#include "Frustum.h"
+#include "JobSystem.h"
+#include "DepthRasterizer.h"
 #include <cstdint>
 #include <vector>
+#include <atomic>
+#include <bit>
+#include <cfloat>
+#include <cstring>
+#include <emmintrin.h>
+
+// fills with non-temporal stores, a full-frame clear doesn't need to pull the buffer through the cache
+static void StreamFill(uint32_t* pDestination, size_t count, uint32_t value)
+{
+	size_t i = 0;
+
+	// scalar stores until we're 16 byte aligned
+	for (; i < count && (reinterpret_cast<uintptr_t>(pDestination + i) & 15); ++i)
+	{
+		pDestination[i] = value;
+	}
+
+	const __m128i packed = _mm_set1_epi32(static_cast<int>(value));
+
+	for (; i + 4 <= count; i += 4)
+	{
+		_mm_stream_si128(reinterpret_cast<__m128i*>(pDestination + i), packed);
+	}
+
+	for (; i < count; ++i)
+	{
+		pDestination[i] = value;
+	}
+
+	_mm_sfence();
+}
+
+// standard 4x rotated grid pattern, in pixels relative to the single sample position
+static const Vector2 MsaaSampleOffsets[4] = {
+	{ -2.f / 16.f, -6.f / 16.f },
+	{ 6.f / 16.f, -2.f / 16.f },
+	{ -6.f / 16.f, 2.f / 16.f },
+	{ 2.f / 16.f, 6.f / 16.f }
+};
+
+// p * M with the matrix rows kept in registers, one vertex (xyzw) per register
+struct SimdMatrix
+{
+	__m128 rows[4];
+
+	explicit SimdMatrix(const Matrix& matrix)
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			const Vector4 row = matrix[i];
+			rows[i] = _mm_setr_ps(row.x, row.y, row.z, row.w);
+		}
+	}
+
+	__m128 TransformVector(const Vector3& v) const
+	{
+		return _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(v.x), rows[0]), _mm_mul_ps(_mm_set1_ps(v.y), rows[1])), _mm_mul_ps(_mm_set1_ps(v.z), rows[2]));
+	}
+
+	__m128 TransformPoint(const Vector3& p) const
+	{
+		return _mm_add_ps(TransformVector(p), rows[3]);
+	}
+};
+
+static Vector3 ToVector3(__m128 v)
+{
+	alignas(16) float values[4];
+	_mm_store_ps(values, v);
+	return { values[0], values[1], values[2] };
+}
 
 SoftwareRenderer::SoftwareRenderer(SDL_Window* pWindow, Camera* camera) :
 	m_pWindow(pWindow), m_pCamera(camera)
 {
 	//Initialize
-	SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
+	SDL_GetWindowSize(pWindow, &m_OutputWidth, &m_OutputHeight);
+	m_Width = m_OutputWidth;
+	m_Height = m_OutputHeight;
 
 	//Create Buffers
 	m_pFrontBuffer = SDL_GetWindowSurface(pWindow);
-	m_pBackBuffer = SDL_CreateRGBSurface(0, m_Width, m_Height, 32, 0, 0, 0, 0);
+
+	// render straight into the window surface when it has a layout we can write to directly (32 bit, tightly packed,
+	// 8 bits per color channel as PackColor assumes), only fall back to a separate back buffer (+ blit on present) when it doesn't
+	const SDL_PixelFormat* pFormat = m_pFrontBuffer->format;
+	const auto isByteMask = [](uint32_t mask, uint8_t shift) { return mask == (0xFFu << shift); };
+
+	if (pFormat->BytesPerPixel == 4 && m_pFrontBuffer->pitch == m_Width * 4 &&
+		isByteMask(pFormat->Rmask, pFormat->Rshift) && isByteMask(pFormat->Gmask, pFormat->Gshift) && isByteMask(pFormat->Bmask, pFormat->Bshift))
+	{
+		m_pBackBuffer = m_pFrontBuffer;
+	}
+	else
+	{
+		m_pBackBuffer = SDL_CreateRGBSurfaceWithFormat(0, m_Width, m_Height, 32, SDL_PIXELFORMAT_ARGB8888);
+	}
+
 	m_pBackBufferPixels = (uint32_t*)m_pBackBuffer->pixels;
 
-	m_pDepthBufferPixels = new float[m_Width * m_Height];
+	// resolve the pixel format once, so pixels can be packed without going through SDL_MapRGB
+	m_RedShift = m_pBackBuffer->format->Rshift;
+	m_GreenShift = m_pBackBuffer->format->Gshift;
+	m_BlueShift = m_pBackBuffer->format->Bshift;
+	m_AlphaMask = m_pBackBuffer->format->Amask;
+
+	m_pDepthBuffer = new DepthBuffer(m_Width, m_Height);
+	m_pTiles = new TileGrid(m_Width, m_Height);
 }
 
 SoftwareRenderer::~SoftwareRenderer()
 {
-	delete[] m_pDepthBufferPixels;
+	if (m_pBackBuffer != m_pFrontBuffer)
+	{
+		SDL_FreeSurface(m_pBackBuffer);
+	}
+
+	delete m_pOutput;
+	delete m_pDepthBuffer;
+	delete m_pTiles;
 }
 
 void SoftwareRenderer::Render(const std::vector<Mesh*>& meshes)
 {
-	// Lock BackBuffer
-	SDL_LockSurface(m_pBackBuffer);
+	// only render first mesh, not the fire particles
+	Mesh* pMesh = meshes[0];
 
-	// Clear BackBuffer
-	// convert rgb to decimal
-	auto decimalColor = (100 << 16) + (100 << 8) + 100;
+	// already culled as a whole by the renderer
+	m_SingleInstance.resize(pMesh->IsCulled() ? 0 : 1);
 
-	if (m_UseUniformColor)
+	for (Instance& instance : m_SingleInstance)
 	{
-		decimalColor = (25 << 16) + (25 << 8) + 25;
+		instance.worldMatrix = pMesh->GetWorldMatrix();
 	}
-	
-	SDL_FillRect(m_pBackBuffer, NULL, decimalColor);
 
-	// Initialize Depth buffer
-	std::fill_n(m_pDepthBufferPixels, m_Width * m_Height, 99999999999999.0f);
+	RenderInstanced(pMesh, m_SingleInstance);
+}
+
+void SoftwareRenderer::RenderInstanced(Mesh* pMesh, const std::vector<Instance>& instances)
+{
+	m_IsIdle = !UpdateDirtyTiles(pMesh, instances);
 
-	// only render first mesh, not the fire particles
-	std::vector<Mesh::Vertex_Out> verticesOut;
-	VertexTransformationFunction(meshes[0], verticesOut);
-	RenderMesh(meshes[0], verticesOut);
+	if (m_IsIdle)
+	{
+		return;
+	}
 
-	SDL_UnlockSurface(m_pBackBuffer);
-	SDL_BlitSurface(m_pBackBuffer, 0, m_pFrontBuffer, 0);
-	SDL_UpdateWindowSurface(m_pWindow);
+	if (!m_PipelineFrames)
+	{
+		FrameData& frame = m_Frames[0];
+		CaptureFrame(frame, pMesh, instances);
+		ProcessGeometry(frame, pMesh);
+		RasterizeFrame(frame);
+		return;
+	}
+
+	// geometry of this frame runs on a worker while the previous frame gets rasterized & presented,
+	// what ends up on screen lags one frame behind in exchange
+	FrameData& previous = m_Frames[m_FrameIndex];
+	FrameData& current = m_Frames[1 - m_FrameIndex];
+
+	if (!previous.isValid)
+	{
+		// first pipelined frame, nothing in flight yet
+		CaptureFrame(previous, pMesh, instances);
+		ProcessGeometry(previous, pMesh);
+	}
+
+	CaptureFrame(current, pMesh, instances);
+
+	JobSystem& jobs = JobSystem::Get();
+	JobSystem::Counter geometry{};
+	jobs.Run([this, &current, pMesh]() { ProcessGeometry(current, pMesh); }, &geometry);
+
+	RasterizeFrame(previous);
+	jobs.Wait(geometry);
+
+	m_FrameIndex = 1 - m_FrameIndex;
 }
 
 void SoftwareRenderer::SetTextures(Texture* pTexture, Texture* pNormal, Texture* pGloss, Texture* pSpecular)
 {
+	InvalidateFrame();
+
 	m_pTexture = pTexture;
 	m_pNormal = pNormal;
 	m_pGloss = pGloss;
 	m_pSpecular = pSpecular;
 }
 
-void SoftwareRenderer::VertexTransformationFunction(Mesh* mesh, std::vector<Mesh::Vertex_Out>& verticesOut) const
+template<typename Job>
+void SoftwareRenderer::ForEachLodVertex(const FrameData& frame, Mesh* mesh, bool skipMeshletInstances, const Job& job) const
 {
-	auto worldMatrix = mesh->GetWorldMatrix();
-	auto verticesIn = mesh->GetVertices();
+	const auto& lods = mesh->GetLods();
+	const auto& lodVertices = mesh->GetLodVertices();
 
-	Matrix matrix{ worldMatrix * m_pCamera->viewMatrix * m_pCamera->projectionMatrix };
-	
-	verticesOut.clear();
-	verticesOut.reserve(verticesIn.size());
+	// where every instance's vertices start in one long list, instances that get nothing take up no room
+	std::vector<size_t> starts(frame.instances.size() + 1);
+
+	for (size_t i{}; i < frame.instances.size(); ++i)
+	{
+		const InstanceData& instance = frame.instances[i];
+		const bool isSkipped = skipMeshletInstances && frame.useMeshlets && instance.lod == 0;
+		starts[i + 1] = starts[i] + (isSkipped ? 0 : lods[instance.lod].vertexCount);
+	}
+
+	JobSystem::Get().ParallelFor(starts.back(), 2048, [&](size_t begin, size_t end)
+	{
+		// a range can span the end of one instance & the start of the next
+		while (begin < end)
+		{
+			const size_t instanceIndex = std::upper_bound(starts.begin(), starts.end(), begin) - starts.begin() - 1;
+			const InstanceData& instance = frame.instances[instanceIndex];
+			const size_t count = std::min(end, starts[instanceIndex + 1]) - begin;
+
+			job(instance, &lodVertices[lods[instance.lod].vertexOffset + (begin - starts[instanceIndex])], count);
+			begin += count;
+		}
+	});
+}
+
+void SoftwareRenderer::VertexTransformationFunction(FrameData& frame, Mesh* mesh) const
+{
+	const auto& verticesIn = mesh->GetVertices();
+	frame.vertices.resize(verticesIn.size() * frame.instances.size());
 
-	for (size_t i{}; i < verticesIn.size(); ++i)
+	// the shared vertex data gets streamed through once per instance, but only the vertices its level of detail uses.
+	// instances going through meshlet culling transform theirs per visible meshlet
+	ForEachLodVertex(frame, mesh, true, [&](const InstanceData& instance, const uint32_t* pIndices, size_t count)
 	{
-		Mesh::Vertex_Out v{};
+		TransformVertices(frame, instance, verticesIn.data(), pIndices, count, &frame.vertices[instance.vertexOffset]);
+	});
+}
+
+void SoftwareRenderer::TransformVertices(const FrameData& frame, const InstanceData& instance, const Mesh::Vertex_In* pVerticesIn, const uint32_t* pIndices, size_t count, Mesh::Vertex_Out* pVerticesOut) const
+{
+	switch (frame.shaderProgram)
+	{
+		case ShaderProgram::TransparentEffect:
+			TransformVertices<TransparentEffectShader>(frame, instance, pVerticesIn, pIndices, count, pVerticesOut);
+			break;
+		case ShaderProgram::Effect:
+		default:
+			TransformVertices<EffectShader>(frame, instance, pVerticesIn, pIndices, count, pVerticesOut);
+			break;
+	}
+}
+
+template<typename Shader>
+void SoftwareRenderer::TransformVertices(const FrameData& frame, const InstanceData& instance, const Mesh::Vertex_In* pVerticesIn, const uint32_t* pIndices, size_t count, Mesh::Vertex_Out* pVerticesOut) const
+{
+	// matrices & viewport get loaded once for the whole batch
+	const SimdMatrix worldViewProjection{ instance.worldViewProjection };
+	const SimdMatrix world{ instance.worldMatrix };
+
+	const float halfWidth = m_Width * 0.5f;
+	const float halfHeight = m_Height * 0.5f;
+	const __m128 viewportScale = _mm_setr_ps(halfWidth, -halfHeight, 1.f, 0.f);
+	const __m128 viewportBias = _mm_setr_ps(halfWidth, halfHeight, 0.f, 0.f);
+	const __m128 wMask = _mm_setr_ps(0.f, 0.f, 0.f, 1.f);
+
+	for (size_t i{}; i < count; ++i)
+	{
+		// either the next vertex or the next one of the index list, written to the same slot it was read from
+		const size_t index = pIndices ? pIndices[i] : i;
+		const Mesh::Vertex_In& vertexIn = pVerticesIn[index];
+		Mesh::Vertex_Out& v = pVerticesOut[index];
+
+		// perspective divide & viewport on xyz, w keeps the clip space w for perspective correct interpolation
+		const __m128 clip = worldViewProjection.TransformPoint(vertexIn.position);
+		const __m128 w = _mm_shuffle_ps(clip, clip, _MM_SHUFFLE(3, 3, 3, 3));
+		const __m128 screen = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_div_ps(clip, w), viewportScale), viewportBias), _mm_mul_ps(w, wMask));
+		_mm_storeu_ps(&v.position.x, screen);
+
+		// only what the shader's stages read
+		if constexpr ((Shader::VertexOutputs & VaryingColor) != 0)
+		{
+			v.color = vertexIn.color;
+		}
 
-		v.position = matrix.TransformPoint({ verticesIn[i].position, 1.f });
+		if constexpr ((Shader::VertexOutputs & VaryingUv) != 0)
+		{
+			v.uv = vertexIn.uv;
+		}
 
-		v.position.x /= v.position.w;
-		v.position.y /= v.position.w;
-		v.position.z /= v.position.w;
+		if constexpr ((Shader::VertexOutputs & VaryingNormal) != 0)
+		{
+			v.normal = ToVector3(world.TransformVector(vertexIn.normal));
+		}
 
-		v.position.x = ((1.f + v.position.x) / 2.f) * m_Width;
-		v.position.y = ((1.f - v.position.y) / 2.f) * m_Height;
+		if constexpr ((Shader::VertexOutputs & VaryingTangent) != 0)
+		{
+			v.tangent = ToVector3(world.TransformVector(vertexIn.tangent));
+		}
 
-		v.color = verticesIn[i].color;
-		v.uv = verticesIn[i].uv;
-		v.normal = worldMatrix.TransformVector(verticesIn[i].normal);
-		v.tangent = worldMatrix.TransformVector(verticesIn[i].tangent);
+		if constexpr ((Shader::VertexOutputs & VaryingWorldPosition) != 0)
+		{
+			if (frame.shaderContext.pLights || frame.useShadows)
+			{
+				v.worldPosition = ToVector3(world.TransformPoint(vertexIn.position));
+			}
+		}
 
-		verticesOut.emplace_back(v);
+		Shader::VertexStage(frame.shaderContext, vertexIn, instance.worldMatrix, v);
 	}
 }
 
-bool SoftwareRenderer::SaveBufferToImage() const
+bool SoftwareRenderer::SaveBufferToImage()
 {
+	// copied into the output ring, the output thread writes it while the next frames render
+	if (m_AsyncOutput)
+	{
+		return m_pOutput->Submit(m_pBackBuffer, "Rasterizer_ColorBuffer.bmp");
+	}
+
 	return SDL_SaveBMP(m_pBackBuffer, "Rasterizer_ColorBuffer.bmp");
 }
 
 void SoftwareRenderer::ToggleDepthBufferVisualization()
 {
+	InvalidateFrame();
+
 	m_DepthBufferVisualization = !m_DepthBufferVisualization;
 	auto text = m_DepthBufferVisualization ? "On" : "Off";
 	std::cout << "Toggled Depth Visualization " << m_DepthBufferVisualization << "\n";
@@ -112,6 +341,8 @@ void SoftwareRenderer::ToggleDepthBufferVisualization()
 
 void SoftwareRenderer::ToggleNormalMap()
 {
+	InvalidateFrame();
+
 	m_UseNormalMap = !m_UseNormalMap;
 	auto text = m_UseNormalMap ? "On" : "Off";
 	std::cout << "Toggled Normal Map " << text << "\n";
@@ -119,6 +350,8 @@ void SoftwareRenderer::ToggleNormalMap()
 
 void SoftwareRenderer::CycleLightingMode()
 {
+	InvalidateFrame();
+
 	m_LightingMode = LightingMode(((int)m_LightingMode + 1) % (int)LightingMode::End);
 
 	auto text = m_LightingMode == LightingMode::ObservedArea ? "Observed Area" : m_LightingMode == LightingMode::Diffuse ? "Diffuse" : m_LightingMode == LightingMode::Specular ? "Specular" : "Combined";
@@ -127,225 +360,1497 @@ void SoftwareRenderer::CycleLightingMode()
 
 void dae::SoftwareRenderer::ToggleBoundingBoxVisualization()
 {
+	InvalidateFrame();
+
 	m_BoundingBoxVisualization = !m_BoundingBoxVisualization;
 	auto text = m_BoundingBoxVisualization ? "On" : "Off";
 	std::cout << "Toggled Bounding Box Visualization " << text << "\n";
 }
 
-// Private functions
-void SoftwareRenderer::RenderTriangle(const Mesh::Vertex_Out& v0, const Mesh::Vertex_Out& v1, const Mesh::Vertex_Out& v2) const
+void SoftwareRenderer::TogglePipelinedFrames()
 {
-	// Frustum culling x & y
-	if (v0.position.x < 0 || v1.position.x < 0 || v2.position.x < 0 ||
-		v0.position.x > m_Width || v1.position.x > m_Width || v2.position.x > m_Width ||
-		v0.position.y < 0 || v1.position.y < 0 || v2.position.y < 0 ||
-		v0.position.y > m_Height || v1.position.y > m_Height || v2.position.y > m_Height)
+	InvalidateFrame();
+
+	m_PipelineFrames = !m_PipelineFrames;
+
+	// whatever is in flight was built for the other mode
+	m_Frames[0].isValid = false;
+	m_Frames[1].isValid = false;
+	m_FrameIndex = 0;
+
+	auto text = m_PipelineFrames ? "On" : "Off";
+	std::cout << "Toggled Pipelined Frames " << text << "\n";
+}
+
+void SoftwareRenderer::ToggleAsyncOutput()
+{
+	m_AsyncOutput = !m_AsyncOutput;
+
+	if (!m_pOutput)
 	{
-		return;
+		m_pOutput = new FrameOutput(m_pBackBuffer->format->format, m_pBackBuffer->w, m_pBackBuffer->h);
 	}
 
-	Vector2 edge0 = { v2.position.GetXY() - v1.position.GetXY() };
-	Vector2 edge1 = { v0.position.GetXY() - v2.position.GetXY() };
-	Vector2 edge2 = { v1.position.GetXY() - v0.position.GetXY() };
+	auto text = m_AsyncOutput ? "On" : "Off";
+	std::cout << "Toggled Async Output " << text << "\n";
+}
 
-	float area = Vector2::Cross(edge0, edge1);
+void SoftwareRenderer::ToggleMeshletCulling()
+{
+	InvalidateFrame();
 
-	if (area < 1.0f)
+	m_UseMeshletCulling = !m_UseMeshletCulling;
+	auto text = m_UseMeshletCulling ? "On" : "Off";
+	std::cout << "Toggled Meshlet Culling " << text << "\n";
+}
+
+void SoftwareRenderer::ToggleDynamicResolution()
+{
+	m_UseDynamicResolution = !m_UseDynamicResolution;
+
+	// either way, start over from the full resolution
+	m_ResolutionScale = 1.f;
+	ResizeBuffers(m_OutputWidth, m_OutputHeight);
+
+	auto text = m_UseDynamicResolution ? "On" : "Off";
+	std::cout << "Toggled Dynamic Resolution " << text << "\n";
+}
+
+void SoftwareRenderer::UpdateResolutionScale(const Timer* pTimer)
+{
+	const float frameTime = pTimer->GetElapsed();
+
+	// idle frames are mostly spent waiting, they say nothing about the cost of rendering
+	if (!m_UseDynamicResolution || m_IsIdle || frameTime <= 0.f)
 	{
 		return;
 	}
 
-	auto top = std::max<float>(std::max<float>(v0.position.y, v1.position.y), v2.position.y);
-	auto bottom = std::min<float>(std::min<float>(v0.position.y, v1.position.y), v2.position.y);
-	auto left = std::min<float>(std::min<float>(v0.position.x, v1.position.x), v2.position.x);
-	auto right = std::max<float>(std::max<float>(v0.position.x, v1.position.x), v2.position.x);
+	// cost mostly scales with the pixel count, so the side length goes with the square root of the ratio,
+	// and only part of the way so a single slow frame doesn't halve the resolution
+	const float targetScale = m_ResolutionScale * sqrtf(m_TargetFrameTime / frameTime);
+	m_ResolutionScale = Clamp(m_ResolutionScale + (targetScale - m_ResolutionScale) * 0.2f, m_MinResolutionScale, 1.f);
+
+	// 5% steps, so the buffers aren't reallocated for every small change
+	const float appliedScale = roundf(m_ResolutionScale * 20.f) / 20.f;
+	const int width = static_cast<int>(m_OutputWidth * appliedScale + 0.5f);
+	const int height = static_cast<int>(m_OutputHeight * appliedScale + 0.5f);
 
-	for (int px{ static_cast<int>(left) }; px < static_cast<int>(right); ++px)
+	if (width != m_Width || height != m_Height)
 	{
-		for (int py{ static_cast<int>(bottom) }; py < static_cast<int>(top); ++py)
-		{
-			if (m_BoundingBoxVisualization)
-			{
-				m_pBackBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBackBuffer->format,
-					static_cast<uint8_t>(255),
-					static_cast<uint8_t>(255),
-					static_cast<uint8_t>(255));
-				continue;
-			}
+		ResizeBuffers(width, height);
+	}
+}
 
-			Vector2 pixel{ static_cast<float>(px), static_cast<float>(py) };
+void SoftwareRenderer::CycleShadingRate()
+{
+	InvalidateFrame();
 
-			Vector2 p0ToPixel = pixel - v0.position.GetXY();
-			auto w2 = Vector2::Cross(edge2, p0ToPixel) / area;
+	m_ShadingRateMode = ShadingRateMode(((int)m_ShadingRateMode + 1) % (int)ShadingRateMode::End);
 
-			if (w2 < 0.0f)
-			{
-				continue;
-			}
+	auto text = m_ShadingRateMode == ShadingRateMode::Full ? "Full" : m_ShadingRateMode == ShadingRateMode::Coarse2x1 ? "2x1" : m_ShadingRateMode == ShadingRateMode::Coarse1x2 ? "1x2" : m_ShadingRateMode == ShadingRateMode::Coarse2x2 ? "2x2" : "Foveated";
+	std::cout << "Toggled Shading Rate To: " << text << "\n";
+}
+
+void SoftwareRenderer::ToggleMsaa()
+{
+	m_UseMsaa = !m_UseMsaa;
 
-			Vector2 p1ToPixel = pixel - v1.position.GetXY();
-			auto w0 = Vector2::Cross(edge0, p1ToPixel) / area;
+	// reallocates depth & sample buffers for the new sample count
+	ResizeBuffers(m_Width, m_Height);
 
-			if (w0 < 0.0f)
-			{
-				continue;
-			}
+	auto text = m_UseMsaa ? "On" : "Off";
+	std::cout << "Toggled 4x MSAA " << text << "\n";
+}
 
-			Vector2 p2ToPixel = pixel - v2.position.GetXY();
-			auto w1 = Vector2::Cross(edge1, p2ToPixel) / area;
+void SoftwareRenderer::ToggleDirtyTracking()
+{
+	InvalidateFrame();
 
-			if (w1 < 0.0f)
-			{
-				continue;
-			}
+	m_UseDirtyTracking = !m_UseDirtyTracking;
+	auto text = m_UseDirtyTracking ? "On" : "Off";
+	std::cout << "Toggled Dirty Tracking " << text << "\n";
+}
 
-			// Deoth Buffer
-			float depthBuffer = 1.f / (w0 / v0.position.z + w1 / v1.position.z + w2 / v2.position.z);
+void SoftwareRenderer::ToggleVertexTangentSpace()
+{
+	InvalidateFrame();
 
-			// frustum culling z + depth test
-			if (depthBuffer < 0 || depthBuffer > 1 ||
-				depthBuffer > m_pDepthBufferPixels[px + py * m_Width])
-			{
-				continue;
-			}
+	m_UseVertexTangentSpace = !m_UseVertexTangentSpace;
+	auto text = m_UseVertexTangentSpace ? "On" : "Off";
+	std::cout << "Toggled Per-Vertex Tangent Space " << text << "\n";
+}
 
-			m_pDepthBufferPixels[px + py * m_Width] = depthBuffer;
+void SoftwareRenderer::CycleShadowMode()
+{
+	InvalidateFrame();
 
-			// actual depth
-			w0 /= v0.position.w;
-			w1 /= v1.position.w;
-			w2 /= v2.position.w;
+	m_ShadowMode = ShadowMode((int(m_ShadowMode) + 1) % int(ShadowMode::End));
+	auto text = m_ShadowMode == ShadowMode::Off ? "Off" : m_ShadowMode == ShadowMode::Hard ? "Hard" : "3x3 PCF";
+	std::cout << "Toggled Shadows To: " << text << "\n";
+}
 
-			auto depth = 1.0f / (w0 + w1 + w2);
+void SoftwareRenderer::ToggleDepthPrepass()
+{
+	m_UseDepthPrepass = !m_UseDepthPrepass;
 
-			ColorRGB finalColor{};
+	// allocates or frees the prepass depth
+	ResizeBuffers(m_Width, m_Height);
 
-			if (m_DepthBufferVisualization)
-			{
-				// Remap so it isnt too bright 
-				depthBuffer = (depthBuffer - 0.985f) / (1.0f - 0.985f);
+	auto text = m_UseDepthPrepass ? "On" : "Off";
+	std::cout << "Toggled Depth Prepass " << text << "\n";
+}
 
-				depthBuffer = Clamp(depthBuffer, 0.f, 1.f);
-				finalColor = { depthBuffer, depthBuffer, depthBuffer };
-			}
-			else
-			{
-				Mesh::Vertex_Out shadingVertex{};
-				shadingVertex.position.x = (float)px;
-				shadingVertex.position.y = (float)py;
-				shadingVertex.color = (w0 * v0.color + w1 * v1.color + w2 * v2.color) * depth;
-				shadingVertex.uv = (w0 * v0.uv + w1 * v1.uv + w2 * v2.uv) * depth;
-				shadingVertex.normal = ((w0 * v0.normal + w1 * v1.normal + w2 * v2.normal) * depth).Normalized();
-				shadingVertex.tangent = ((w0 * v0.tangent + w1 * v1.tangent + w2 * v2.tangent) * depth).Normalized();
-
-				finalColor = PixelShading(shadingVertex);
-			}
+void SoftwareRenderer::ToggleOverdrawCounter()
+{
+	m_CountOverdraw = !m_CountOverdraw;
+	m_ShadedSamples = 0;
+	m_CoveredSamples = 0;
 
-			finalColor.MaxToOne();
+	auto text = m_CountOverdraw ? "On" : "Off";
+	std::cout << "Toggled Overdraw Counter " << text << "\n";
+}
 
-			m_pBackBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBackBuffer->format,
-				static_cast<uint8_t>(finalColor.r * 255),
-				static_cast<uint8_t>(finalColor.g * 255),
-				static_cast<uint8_t>(finalColor.b * 255));
-		}
+void SoftwareRenderer::CycleShaderProgram()
+{
+	InvalidateFrame();
+
+	m_ShaderProgram = ShaderProgram((int(m_ShaderProgram) + 1) % int(ShaderProgram::End));
+	auto text = m_ShaderProgram == ShaderProgram::Effect ? "Effect" : "Transparent Effect";
+	std::cout << "Toggled Software Shader To: " << text << "\n";
+}
+
+void SoftwareRenderer::ToggleFastMath()
+{
+	InvalidateFrame();
+
+	m_UseFastMath = !m_UseFastMath;
+	auto text = m_UseFastMath ? "On" : "Off";
+	std::cout << "Toggled Fast Shading Math " << text << "\n";
+
+	if (m_UseFastMath)
+	{
+		ReportFastMathError();
 	}
 }
 
-void SoftwareRenderer::RenderMesh(Mesh* mesh, std::vector<Mesh::Vertex_Out>& vertices) const
+void SoftwareRenderer::ReportFastMathError() const
 {
-	auto indices = mesh->GetIndices();
+	// every gloss the shader can see (8 bit gloss map * shine) against a sweep of reflection cosines
+	const float shine = 25.0f;
+	float maxPowError = 0.f;
+	double totalPowError = 0.0;
+	int powSamples = 0;
 
-	if (mesh->GetPrimitiveTopology() == Mesh::PrimitiveTopology::TriangleList)
+	for (int level = 1; level < 256; ++level)
 	{
-		for (size_t i = 0; i < indices.size() - 2; i += 3)
+		const float gloss = shine * (level / 255.f);
+
+		for (int i = 0; i <= 1024; ++i)
 		{
-			RenderTriangle(vertices[indices[i]], vertices[indices[i + 1]], vertices[indices[i + 2]]);
+			const float cosine = i / 1024.f;
+			const float error = fabsf(FastPow(cosine, gloss) - powf(cosine, gloss));
+
+			maxPowError = std::max(maxPowError, error);
+			totalPowError += error;
+			++powSamples;
 		}
 	}
-	else if (mesh->GetPrimitiveTopology() == Mesh::PrimitiveTopology::TriangleStrip)
+
+	// unnormalized interpolated vectors cover roughly [0.1, 10] in length
+	float maxNormalizeError = 0.f;
+
+	for (int i = 0; i < 64; ++i)
 	{
-		for (size_t i = 0; i < indices.size() - 2; ++i)
+		for (int j = 0; j < 64; ++j)
 		{
-			// try optimize without if statement, either 2 for loops or just adding/substracting the result of the modulo directly
-			if (i % 2)
-			{
-				RenderTriangle(vertices[indices[i]], vertices[indices[i + 2]], vertices[indices[i + 1]]);
-			}
-			else
-			{
-				RenderTriangle(vertices[indices[i]], vertices[indices[i + 1]], vertices[indices[i + 2]]);
-			}
+			const float theta = i * (PI / 63.f);
+			const float phi = j * (PI_2 / 64.f);
+			const float length = 0.1f + (i * 64 + j) * (9.9f / 4095.f);
+			const Vector3 v = Vector3{ sinf(theta) * cosf(phi), sinf(theta) * sinf(phi), cosf(theta) } * length;
+
+			const Vector3 difference = Normalized(v, true) - Normalized(v, false);
+			maxNormalizeError = std::max(maxNormalizeError, difference.Magnitude());
 		}
 	}
+
+	std::cout << "  Fast pow: max error " << maxPowError << ", mean " << totalPowError / powSamples
+		<< " (" << maxPowError * 255.f << " of an 8 bit step)\n";
+	std::cout << "  Fast normalize: max error " << maxNormalizeError << "\n";
 }
 
-ColorRGB SoftwareRenderer::PixelShading(const Mesh::Vertex_Out& v) const
+void SoftwareRenderer::CycleDepthFormat()
 {
-	Vector3 lightDirection = { .577f, -.577f, .577f };
-	Vector3 normal{ v.normal };
+	InvalidateFrame();
 
-	// Create viewDirection
-	float x = (2 * (v.position.x + 0.5f / float(m_Width)) - 1) * m_pCamera->aspectRatio * m_pCamera->fov;
-	float y = (1 - (2 * (v.position.y + 0.5f / float(m_Height)))) * m_pCamera->fov;
+	m_pDepthBuffer->SetFormat(DepthBuffer::Format(((int)m_pDepthBuffer->GetFormat() + 1) % (int)DepthBuffer::Format::End));
 
-	Vector3 viewDirection = (x * m_pCamera->right + y * m_pCamera->up + m_pCamera->forward).Normalized();
+	auto format = m_pDepthBuffer->GetFormat();
+	auto text = format == DepthBuffer::Format::Float32 ? "Float32" : format == DepthBuffer::Format::Float32Reversed ? "Float32 Reversed-Z" : format == DepthBuffer::Format::Unorm24 ? "Unorm24" : "Unorm16";
+	std::cout << "Toggled Depth Format To: " << text << "\n";
+}
 
-	if (m_UseNormalMap)
-	{
-		// Create tangent space transformation matrix
-		Vector3 binormal = Vector3::Cross(v.normal, v.tangent);
-		Matrix tangentSpaceAxis{ v.tangent, binormal, v.normal, Vector3::Zero };
+// Private functions
+bool SoftwareRenderer::UpdateDirtyTiles(Mesh* pMesh, const std::vector<Instance>& instances)
+{
+	m_DirtyTiles.clear();
 
-		// sample and remap color to [-1, 1]
-		ColorRGB sampledColor = m_pNormal->Sample(v.uv);
-		sampledColor = (2.f * sampledColor) - ColorRGB{ 1.f, 1.f, 1.f };
+	// anything that affects every pixel, pipelined frames lag behind so they always render in full
+	const bool isFullFrame = !m_UseDirtyTracking || m_PipelineFrames ||
+		m_SettingsVersion != m_RenderedSettingsVersion ||
+		m_pCamera->version != m_RenderedCameraVersion ||
+		pMesh != m_pRenderedMesh ||
+		instances.size() != m_RenderedInstances.size();
 
-		normal = tangentSpaceAxis.TransformVector(sampledColor.r, sampledColor.g, sampledColor.b);
+	m_RenderedSettingsVersion = m_SettingsVersion;
+	m_RenderedCameraVersion = m_pCamera->version;
+	m_pRenderedMesh = pMesh;
+
+	if (isFullFrame)
+	{
+		m_RenderedInstances = instances;
+		return true;
 	}
 
-	float dot = normal * -lightDirection;
+	// the camera didn't move, so only the screen area an instance left or entered changed
+	const Matrix viewProjection = m_pCamera->viewMatrix * m_pCamera->projectionMatrix;
+	bool hasChanges = false;
 
-	if (dot < 0.f)
+	for (size_t i = 0; i < instances.size(); ++i)
 	{
-		return {};
+		const Instance& instance = instances[i];
+		const Instance& rendered = m_RenderedInstances[i];
+
+		if (memcmp(&instance.worldMatrix, &rendered.worldMatrix, sizeof(Matrix)) == 0 &&
+			instance.tint.r == rendered.tint.r && instance.tint.g == rendered.tint.g && instance.tint.b == rendered.tint.b)
+		{
+			continue;
+		}
+
+		if (!hasChanges)
+		{
+			m_DirtyTiles.assign(m_pTiles->GetTileCount(), false);
+			hasChanges = true;
+		}
+
+		MarkDirtyTiles(pMesh, rendered.worldMatrix * viewProjection);
+		MarkDirtyTiles(pMesh, instance.worldMatrix * viewProjection);
 	}
 
-	ColorRGB finalColor{};
-	auto lightIntensity = 7.0f;
-	auto shine = 25.0f;
+	m_RenderedInstances = instances;
+
+	return hasChanges;
+}
+
+void SoftwareRenderer::MarkDirtyTiles(Mesh* pMesh, const Matrix& worldViewProjection)
+{
+	const Vector3& min = pMesh->GetBoundsMin();
+	const Vector3& max = pMesh->GetBoundsMax();
 
-	float dot2 = -1;
+	float left = FLT_MAX, right = -FLT_MAX, top = FLT_MAX, bottom = -FLT_MAX;
 
-	switch (m_LightingMode)
+	for (int corner{}; corner < 8; ++corner)
 	{
-		case SoftwareRenderer::LightingMode::ObservedArea:
-			finalColor = { dot, dot, dot };
-			break;
-		case SoftwareRenderer::LightingMode::Diffuse:
-			finalColor = m_pTexture->Sample(v.uv) * dot * lightIntensity / M_PI;
-			break;
-		case SoftwareRenderer::LightingMode::Specular:
-			finalColor = Phong(m_pSpecular->Sample(v.uv), shine * m_pGloss->Sample(v.uv).r, -lightDirection, viewDirection, normal) * dot;
-			break;
-		case SoftwareRenderer::LightingMode::Combined:
-		default:
-			finalColor = m_pTexture->Sample(v.uv) * dot * lightIntensity / M_PI;
-			finalColor += Phong(m_pSpecular->Sample(v.uv), shine * m_pGloss->Sample(v.uv).r, -lightDirection, viewDirection, normal) * dot;
-			break;
+		const Vector4 clip = worldViewProjection.TransformPoint(Vector4{
+			corner & 1 ? max.x : min.x,
+			corner & 2 ? max.y : min.y,
+			corner & 4 ? max.z : min.z,
+			1.f });
+
+		// crosses the camera plane, the projected box isn't bounded
+		if (clip.w <= 0.f)
+		{
+			std::fill(m_DirtyTiles.begin(), m_DirtyTiles.end(), true);
+			return;
+		}
+
+		const float x = (clip.x / clip.w + 1.f) * 0.5f * m_Width;
+		const float y = (1.f - clip.y / clip.w) * 0.5f * m_Height;
+
+		left = std::min(left, x);
+		right = std::max(right, x);
+		top = std::min(top, y);
+		bottom = std::max(bottom, y);
 	}
 
-	finalColor.MaxToOne();
-	return finalColor;
+	if (right < 0.f || bottom < 0.f || left >= m_Width || top >= m_Height)
+	{
+		return;
+	}
+
+	// a pixel of margin for msaa samples
+	int firstX, firstY, lastX, lastY;
+	m_pTiles->GetTileRange(static_cast<int>(left) - 1, static_cast<int>(top) - 1, static_cast<int>(right) + 1, static_cast<int>(bottom) + 1, firstX, firstY, lastX, lastY);
+
+	for (int ty{ firstY }; ty <= lastY; ++ty)
+	{
+		for (int tx{ firstX }; tx <= lastX; ++tx)
+		{
+			m_DirtyTiles[tx + ty * m_pTiles->GetTilesX()] = true;
+		}
+	}
 }
 
-ColorRGB SoftwareRenderer::Phong(ColorRGB specular, float gloss, Vector3 lightDir, Vector3 viewDir, Vector3 normal) const
+void SoftwareRenderer::ResizeBuffers(int width, int height)
 {
-	auto dot = (lightDir - (normal * (2.f * (normal * lightDir)))) * viewDir;
+	InvalidateFrame();
+
+	m_Width = width;
+	m_Height = height;
+
+	m_pDepthBuffer->Resize(width, height, m_UseMsaa ? MsaaSampleCount : 1);
+	m_SamplePixels.resize(m_UseMsaa ? size_t(width) * height * MsaaSampleCount : 0);
+	m_pSamplePixels = m_SamplePixels.data();
+	m_PrepassDepth.resize(m_UseDepthPrepass ? size_t(width) * height * (m_UseMsaa ? MsaaSampleCount : 1) : 0);
+	m_pTiles->Resize(width, height);
+	m_ScaledPixels.resize(size_t(width) * height);
+
+	m_UpscaleColumns.resize(m_OutputWidth);
 
-	if (dot < 0.f)
+	for (int x{}; x < m_OutputWidth; ++x)
 	{
-		return {};
+		m_UpscaleColumns[x] = x * width / m_OutputWidth;
 	}
 
-	return specular * powf(dot, gloss);
+	// old contents don't line up with the new size, force a full clear
+	m_ClearColor = 0;
+
+	// frames in flight were binned for the old tile grid
+	m_Frames[0].isValid = false;
+	m_Frames[1].isValid = false;
+	m_FrameIndex = 0;
+}
+
+void SoftwareRenderer::Upscale(SDL_Surface* pTarget) const
+{
+	uint8_t* pTargetPixels = static_cast<uint8_t*>(pTarget->pixels);
+	const int pitch = pTarget->pitch;
+
+	// nearest neighbour, output rows that map to the same source row as the one above are a plain copy
+	JobSystem::Get().ParallelFor(m_OutputHeight, 32, [&](size_t begin, size_t end)
+	{
+		int previousRow = -1;
+
+		for (size_t y = begin; y < end; ++y)
+		{
+			uint32_t* pRow = reinterpret_cast<uint32_t*>(pTargetPixels + y * pitch);
+			const int sourceRow = static_cast<int>(y) * m_Height / m_OutputHeight;
+
+			if (sourceRow == previousRow)
+			{
+				std::copy_n(reinterpret_cast<const uint32_t*>(pTargetPixels + (y - 1) * pitch), m_OutputWidth, pRow);
+				continue;
+			}
+
+			const uint32_t* pSource = &m_ScaledPixels[size_t(sourceRow) * m_Width];
+
+			for (int x{}; x < m_OutputWidth; ++x)
+			{
+				pRow[x] = pSource[m_UpscaleColumns[x]];
+			}
+
+			previousRow = sourceRow;
+		}
+	});
+}
+
+void SoftwareRenderer::CaptureFrame(FrameData& frame, Mesh* mesh, const std::vector<Instance>& instances) const
+{
+	// everything the geometry stage reads gets copied here on the main thread,
+	// so it can run while the next update already changes camera & meshes
+	frame.isReversed = m_pDepthBuffer->IsReversed();
+	frame.shaderProgram = m_ShaderProgram;
+	frame.useFastMath = m_UseFastMath;
+	// meshlets only exist for the full detail level, instances at other levels skip them
+	frame.useMeshlets = m_UseMeshletCulling && mesh->GetPrimitiveTopology() == Mesh::PrimitiveTopology::TriangleList && !mesh->GetMeshlets().empty();
+	frame.cullBackfacingMeshlets = m_CullMode == Mesh::CullMode::Back;
+	frame.pOcclusion = m_pOcclusion;
+	frame.useShadows = m_ShadowMode != ShadowMode::Off && frame.shaderProgram == ShaderProgram::Effect;
+
+	const Matrix& projectionMatrix = frame.isReversed ? m_pCamera->reversedProjectionMatrix : m_pCamera->projectionMatrix;
+	const Matrix viewProjection = m_pCamera->viewMatrix * projectionMatrix;
+
+	// instances outside the frustum or hidden behind the occluders never take up vertex slots
+	const Frustum frustum{ viewProjection };
+	frame.meshVertexCount = static_cast<uint32_t>(mesh->GetVertices().size());
+	frame.culledInstances = 0;
+	frame.instances.clear();
+
+	// pixels covered by one world unit at distance 1, at output resolution so dynamic resolution doesn't swap levels
+	const float pixelsPerUnit = m_OutputHeight * 0.5f / m_pCamera->fov;
+
+	for (const Instance& instance : instances)
+	{
+		const Matrix& world = instance.worldMatrix;
+		const float scale = std::max(std::max(world.GetAxisX().Magnitude(), world.GetAxisY().Magnitude()), world.GetAxisZ().Magnitude());
+		const Vector3 center = world.TransformPoint(mesh->GetBoundingSphereCenter());
+		const float radius = mesh->GetBoundingSphereRadius() * scale;
+
+		if (!frustum.IsSphereVisible(center, radius) ||
+			(m_pOcclusion && !m_pOcclusion->IsBoxVisible(mesh->GetBoundsMin(), mesh->GetBoundsMax(), world)))
+		{
+			++frame.culledInstances;
+			continue;
+		}
+
+		const float distance = std::max((center - m_pCamera->origin).Magnitude(), m_pCamera->nearPlane);
+		const int lod = mesh->SelectLod(radius * pixelsPerUnit / distance, m_LodScreenRadius);
+
+		const uint32_t vertexOffset = static_cast<uint32_t>(frame.instances.size()) * frame.meshVertexCount;
+		frame.instances.push_back({ world, world * viewProjection, instance.tint, vertexOffset, lod });
+	}
+
+	frame.cameraOrigin = m_pCamera->origin;
+
+	ShaderContext& context = frame.shaderContext;
+	context.pDiffuse = m_pTexture;
+	context.pNormal = m_pNormal;
+	context.pGloss = m_pGloss;
+	context.pSpecular = m_pSpecular;
+	context.cameraOrigin = m_pCamera->origin;
+	context.cameraForward = m_pCamera->forward;
+	context.cameraRight = m_pCamera->right;
+	context.cameraUp = m_pCamera->up;
+	context.fov = m_pCamera->fov;
+	context.aspectRatio = m_pCamera->aspectRatio;
+	context.width = m_Width;
+	context.height = m_Height;
+	// point & spot lights and shadows need world space lighting
+	context.useVertexTangentSpace = m_UseVertexTangentSpace && m_Lights.empty() && !frame.useShadows;
+
+	// the map itself gets rendered with the frame's geometry
+	context.pShadowMap = nullptr;
+	context.shadowFilterRadius = m_ShadowMode == ShadowMode::Pcf ? 1 : 0;
+
+	frame.lights = m_Lights;
+	frame.lightBounds.clear();
+	context.pLights = frame.lights.empty() ? nullptr : frame.lights.data();
+
+	for (const Light& light : frame.lights)
+	{
+		if (light.type == Light::Type::Directional)
+		{
+			frame.lightBounds.push_back({ 0.f, 0.f, 0.f, -1.f });
+			continue;
+		}
+
+		frame.lightBounds.push_back({ m_pCamera->viewMatrix.TransformPoint(light.position), light.range });
+	}
+}
+
+void SoftwareRenderer::ProcessGeometry(FrameData& frame, Mesh* mesh) const
+{
+	frame.culledMeshlets = 0;
+
+	if (frame.instances.empty())
+	{
+		// outside the frustum, skip all vertex work and present an empty frame
+		ResetBins(frame);
+		frame.isValid = true;
+		return;
+	}
+
+	// instances at full detail go through meshlet culling, the others transform & bin their own level
+	VertexTransformationFunction(frame, mesh);
+	ResetBins(frame);
+
+	for (const InstanceData& instance : frame.instances)
+	{
+		if (frame.useMeshlets && instance.lod == 0)
+		{
+			ProcessMeshlets(frame, mesh, instance);
+		}
+		else
+		{
+			BinTriangles(frame, mesh, instance);
+		}
+	}
+
+	if (frame.useShadows)
+	{
+		RenderShadowMap(frame, mesh);
+	}
+
+	frame.isValid = true;
+}
+
+void SoftwareRenderer::RenderShadowMap(FrameData& frame, Mesh* mesh) const
+{
+	ShaderContext& context = frame.shaderContext;
+
+	// orthographic light box around every visible instance, shadows from outside the view frustum are lost
+	Vector3 boundsMin{ FLT_MAX, FLT_MAX, FLT_MAX };
+	Vector3 boundsMax{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	for (const InstanceData& instance : frame.instances)
+	{
+		const Matrix& world = instance.worldMatrix;
+		const float scale = std::max(std::max(world.GetAxisX().Magnitude(), world.GetAxisY().Magnitude()), world.GetAxisZ().Magnitude());
+		const Vector3 center = world.TransformPoint(mesh->GetBoundingSphereCenter());
+		const float radius = mesh->GetBoundingSphereRadius() * scale;
+
+		boundsMin = { std::min(boundsMin.x, center.x - radius), std::min(boundsMin.y, center.y - radius), std::min(boundsMin.z, center.z - radius) };
+		boundsMax = { std::max(boundsMax.x, center.x + radius), std::max(boundsMax.y, center.y + radius), std::max(boundsMax.z, center.z + radius) };
+	}
+
+	const Vector3 center = (boundsMin + boundsMax) * 0.5f;
+	const float radius = (boundsMax - boundsMin).Magnitude() * 0.5f;
+
+	// light space basis looking along the light, any up works as long as it isn't parallel to it
+	const Vector3 forward = context.lightDirection.Normalized();
+	const Vector3 right = Vector3::Cross(abs(forward.y) < 0.99f ? Vector3::UnitY : Vector3::UnitX, forward).Normalized();
+	const Vector3 up = Vector3::Cross(forward, right);
+
+	const float texelScale = ShadowMapSize * 0.5f / radius;
+	const float depthScale = 0.5f / radius;
+
+	context.worldToShadow = Matrix{
+		{ right.x * texelScale, -up.x * texelScale, forward.x * depthScale },
+		{ right.y * texelScale, -up.y * texelScale, forward.y * depthScale },
+		{ right.z * texelScale, -up.z * texelScale, forward.z * depthScale },
+		{ ShadowMapSize * 0.5f - (center * right) * texelScale, ShadowMapSize * 0.5f + (center * up) * texelScale, 0.5f - (center * forward) * depthScale } };
+
+	// about two texels of depth, against acne on surfaces at a grazing angle to the light
+	context.shadowMapSize = ShadowMapSize;
+	context.shadowBias = 2.f / ShadowMapSize;
+
+	// light space positions only, no attributes
+	const auto& verticesIn = mesh->GetVertices();
+	frame.shadowVertices.resize(verticesIn.size() * frame.instances.size());
+
+	// every instance casts its shadow at the level of detail it gets drawn with
+	ForEachLodVertex(frame, mesh, false, [&](const InstanceData& instance, const uint32_t* pIndices, size_t count)
+	{
+		const SimdMatrix worldToShadow{ instance.worldMatrix * context.worldToShadow };
+
+		for (size_t i{}; i < count; ++i)
+		{
+			frame.shadowVertices[instance.vertexOffset + pIndices[i]] = ToVector3(worldToShadow.TransformPoint(verticesIn[pIndices[i]].position));
+		}
+	});
+
+	// bands of rows get rendered in parallel, each only walks the triangles overlapping it
+	const int bandCount = (ShadowMapSize + ShadowBandHeight - 1) / ShadowBandHeight;
+	frame.shadowBands.resize(bandCount);
+
+	for (auto& band : frame.shadowBands)
+	{
+		band.clear();
+	}
+
+	const auto& indices = mesh->GetIndices();
+	const bool isStrip = mesh->GetPrimitiveTopology() == Mesh::PrimitiveTopology::TriangleStrip;
+	const size_t step = isStrip ? 1 : 3;
+
+	for (const InstanceData& instance : frame.instances)
+	{
+		const Mesh::Lod& lod = mesh->GetLods()[instance.lod];
+		const size_t first = isStrip ? 0 : lod.indexOffset;
+
+		// both windings get drawn, so strips don't need their order flipped
+		for (size_t i = first; i + 2 < first + lod.indexCount; i += step)
+		{
+			const uint32_t i0 = instance.vertexOffset + indices[i];
+			const uint32_t i1 = instance.vertexOffset + indices[i + 1];
+			const uint32_t i2 = instance.vertexOffset + indices[i + 2];
+
+			const float minY = std::min({ frame.shadowVertices[i0].y, frame.shadowVertices[i1].y, frame.shadowVertices[i2].y });
+			const float maxY = std::max({ frame.shadowVertices[i0].y, frame.shadowVertices[i1].y, frame.shadowVertices[i2].y });
+			const int firstBand = std::max(static_cast<int>(minY) / ShadowBandHeight, 0);
+			const int lastBand = std::min(static_cast<int>(maxY) / ShadowBandHeight, bandCount - 1);
+
+			for (int band{ firstBand }; band <= lastBand; ++band)
+			{
+				frame.shadowBands[band].insert(frame.shadowBands[band].end(), { i0, i1, i2 });
+			}
+		}
+	}
+
+	frame.shadowMap.resize(size_t(ShadowMapSize) * ShadowMapSize);
+
+	JobSystem::Get().ParallelFor(bandCount, 1, [&](size_t begin, size_t end)
+	{
+		DepthRasterizer rasterizer{};
+		rasterizer.SetTarget(frame.shadowMap.data(), ShadowMapSize, ShadowMapSize, ShadowMapSize, false);
+
+		for (size_t band = begin; band < end; ++band)
+		{
+			const int top = static_cast<int>(band) * ShadowBandHeight;
+			const int bottom = std::min(top + ShadowBandHeight, ShadowMapSize);
+			std::fill(frame.shadowMap.begin() + size_t(top) * ShadowMapSize, frame.shadowMap.begin() + size_t(bottom) * ShadowMapSize, 1.f);
+
+			const auto& triangles = frame.shadowBands[band];
+
+			for (size_t i{}; i < triangles.size(); i += 3)
+			{
+				rasterizer.RasterizeTriangle(frame.shadowVertices[triangles[i]], frame.shadowVertices[triangles[i + 1]], frame.shadowVertices[triangles[i + 2]], 0, top, ShadowMapSize, bottom);
+			}
+		}
+	});
+
+	context.pShadowMap = frame.shadowMap.data();
+}
+
+void SoftwareRenderer::RasterizeFrame(const FrameData& frame)
+{
+	// Lock BackBuffer
+	SDL_LockSurface(m_pBackBuffer);
+
+	// with dynamic resolution the lazy clear state belongs to the scaled buffer, which is always the same one
+	if (m_UseDynamicResolution)
+	{
+		m_pBackBufferPixels = m_ScaledPixels.data();
+	}
+	else
+	{
+		m_pBackBufferPixels = (uint32_t*)m_pBackBuffer->pixels;
+	}
+
+	// Clear BackBuffer
+	auto clearColor = PackColor(100, 100, 100);
+
+	if (m_UseUniformColor)
+	{
+		clearColor = PackColor(25, 25, 25);
+	}
+	
+	// color & depth get cleared per tile once a triangle touches it,
+	// a full clear only happens when the clear color itself changes
+	m_pTiles->BeginFrame();
+
+	if (clearColor != m_ClearColor)
+	{
+		m_ClearColor = clearColor;
+		StreamFill(m_pBackBufferPixels, size_t(m_Width) * m_Height, m_ClearColor);
+		m_pTiles->SetAllColorCleared(true);
+	}
+
+	m_pRasterFrame = &frame;
+
+	// tiles don't share any pixels, so each one can be rasterized by a different worker
+	const int tilesX = m_pTiles->GetTilesX();
+
+	// every per-pixel render state is resolved here, once
+	const TrianglePipeline renderTriangle = s_Pipelines[GetPipelineState(frame)];
+
+	if (m_TileLights.size() != size_t(m_pTiles->GetTileCount()))
+	{
+		m_TileLights.resize(m_pTiles->GetTileCount());
+	}
+
+	// blended shaders have to see everything behind them, and bounding boxes ignore depth
+	const bool useDepthPrepass = m_UseDepthPrepass && frame.shaderProgram == ShaderProgram::Effect && !m_BoundingBoxVisualization;
+	m_pPrepassDepth = useDepthPrepass ? m_PrepassDepth.data() : nullptr;
+
+	std::atomic<uint64_t> shadedSamples{};
+	std::atomic<uint64_t> coveredSamples{};
+
+	JobSystem::Get().ParallelFor(m_pTiles->GetTileCount(), 4, [&](size_t begin, size_t end)
+	{
+		uint64_t jobShadedSamples{};
+		uint64_t jobCoveredSamples{};
+
+		for (size_t i = begin; i < end; ++i)
+		{
+			const auto& bin = frame.bins[i];
+
+			// clean tiles still hold last frame's pixels
+			if (bin.empty() || !IsTileDirty(static_cast<int>(i)))
+			{
+				continue;
+			}
+
+			const int tx = static_cast<int>(i) % tilesX;
+			const int ty = static_cast<int>(i) / tilesX;
+
+			PrepareTile(tx, ty);
+			CullTileLights(frame, tx, ty, m_TileLights[i]);
+
+			if (useDepthPrepass)
+			{
+				RenderDepthPrepass(frame, tx, ty);
+			}
+
+			for (uint32_t triangle : bin)
+			{
+				const uint32_t* pIndices = &frame.triangles[triangle * 3];
+				const ColorRGB& tint = frame.instances[pIndices[0] / frame.meshVertexCount].tint;
+				jobShadedSamples += (this->*renderTriangle)(frame.vertices[pIndices[0]], frame.vertices[pIndices[1]], frame.vertices[pIndices[2]], tint, tx, ty);
+			}
+
+			if (m_CountOverdraw)
+			{
+				jobCoveredSamples += CountCoveredSamples(tx, ty);
+			}
+
+			if (m_UseMsaa)
+			{
+				ResolveTile(tx, ty);
+			}
+		}
+
+		shadedSamples += jobShadedSamples;
+		coveredSamples += jobCoveredSamples;
+	});
+
+	if (m_CountOverdraw)
+	{
+		m_ShadedSamples = shadedSamples;
+		m_CoveredSamples = coveredSamples;
+	}
+
+	ResolveUntouchedTiles();
+
+	if (m_UseDynamicResolution)
+	{
+		Upscale(m_pBackBuffer);
+	}
+
+	SDL_UnlockSurface(m_pBackBuffer);
+
+	// nothing to copy when we rendered into the window surface directly
+	if (m_pBackBuffer != m_pFrontBuffer)
+	{
+		SDL_BlitSurface(m_pBackBuffer, 0, m_pFrontBuffer, 0);
+	}
+
+	SDL_UpdateWindowSurface(m_pWindow);
+}
+
+void SoftwareRenderer::ProcessMeshlets(FrameData& frame, Mesh* mesh, const InstanceData& instance) const
+{
+	const auto& verticesIn = mesh->GetVertices();
+	const auto& meshletVertices = mesh->GetMeshletVertices();
+	const auto& meshletTriangles = mesh->GetMeshletTriangles();
+
+	// cull in object space, saves transforming every meshlet's bounds
+	const Frustum frustum{ instance.worldViewProjection };
+	const Vector3 cameraPosition = Matrix::Inverse(instance.worldMatrix).TransformPoint(frame.cameraOrigin);
+
+	for (const Mesh::Meshlet& meshlet : mesh->GetMeshlets())
+	{
+		if (!frustum.IsSphereVisible(meshlet.center, meshlet.radius))
+		{
+			++frame.culledMeshlets;
+			continue;
+		}
+
+		if (frame.pOcclusion && !frame.pOcclusion->IsSphereVisible(meshlet.center, meshlet.radius, instance.worldMatrix))
+		{
+			++frame.culledMeshlets;
+			continue;
+		}
+
+		// whole cluster faces away from the camera
+		if (frame.cullBackfacingMeshlets && (meshlet.coneApex - cameraPosition).Normalized() * meshlet.coneAxis >= meshlet.coneCutoff)
+		{
+			++frame.culledMeshlets;
+			continue;
+		}
+
+		const uint32_t* pVertices = &meshletVertices[meshlet.vertexOffset];
+		TransformVertices(frame, instance, verticesIn.data(), pVertices, meshlet.vertexCount, &frame.vertices[instance.vertexOffset]);
+
+		const uint8_t* pTriangles = &meshletTriangles[meshlet.triangleOffset * 3];
+		const uint32_t offset = instance.vertexOffset;
+
+		for (uint32_t t = 0; t < meshlet.triangleCount; ++t)
+		{
+			BinTriangle(frame, offset + pVertices[pTriangles[t * 3]], offset + pVertices[pTriangles[t * 3 + 1]], offset + pVertices[pTriangles[t * 3 + 2]]);
+		}
+	}
+}
+
+void SoftwareRenderer::ResetBins(FrameData& frame) const
+{
+	frame.triangles.clear();
+	frame.bins.resize(m_pTiles->GetTileCount());
+
+	for (auto& bin : frame.bins)
+	{
+		bin.clear();
+	}
+}
+
+void SoftwareRenderer::BinTriangles(FrameData& frame, Mesh* mesh, const InstanceData& instance) const
+{
+	const auto& indices = mesh->GetIndices();
+	const Mesh::Lod& lod = mesh->GetLods()[instance.lod];
+	const uint32_t o = instance.vertexOffset;
+
+	if (mesh->GetPrimitiveTopology() == Mesh::PrimitiveTopology::TriangleList)
+	{
+		for (size_t i = lod.indexOffset; i + 2 < lod.indexOffset + lod.indexCount; i += 3)
+		{
+			BinTriangle(frame, o + indices[i], o + indices[i + 1], o + indices[i + 2]);
+		}
+	}
+	else if (mesh->GetPrimitiveTopology() == Mesh::PrimitiveTopology::TriangleStrip)
+	{
+		for (size_t i = 0; i + 2 < lod.indexCount; ++i)
+		{
+			// try optimize without if statement, either 2 for loops or just adding/substracting the result of the modulo directly
+			if (i % 2)
+			{
+				BinTriangle(frame, o + indices[i], o + indices[i + 2], o + indices[i + 1]);
+			}
+			else
+			{
+				BinTriangle(frame, o + indices[i], o + indices[i + 1], o + indices[i + 2]);
+			}
+		}
+	}
+}
+
+void SoftwareRenderer::BinTriangle(FrameData& frame, uint32_t index0, uint32_t index1, uint32_t index2) const
+{
+	const Vector4& p0 = frame.vertices[index0].position;
+	const Vector4& p1 = frame.vertices[index1].position;
+	const Vector4& p2 = frame.vertices[index2].position;
+
+	// Frustum culling x & y
+	if (p0.x < 0 || p1.x < 0 || p2.x < 0 ||
+		p0.x > m_Width || p1.x > m_Width || p2.x > m_Width ||
+		p0.y < 0 || p1.y < 0 || p2.y < 0 ||
+		p0.y > m_Height || p1.y > m_Height || p2.y > m_Height)
+	{
+		return;
+	}
+
+	// back facing or too small to cover anything
+	if (Vector2::Cross(p2.GetXY() - p1.GetXY(), p0.GetXY() - p2.GetXY()) < 1.0f)
+	{
+		return;
+	}
+
+	const int left = static_cast<int>(std::min<float>(std::min<float>(p0.x, p1.x), p2.x));
+	const int right = static_cast<int>(std::max<float>(std::max<float>(p0.x, p1.x), p2.x));
+	const int bottom = static_cast<int>(std::min<float>(std::min<float>(p0.y, p1.y), p2.y));
+	const int top = static_cast<int>(std::max<float>(std::max<float>(p0.y, p1.y), p2.y));
+
+	if (right <= left || top <= bottom)
+	{
+		return;
+	}
+
+	const uint32_t triangle = static_cast<uint32_t>(frame.triangles.size() / 3);
+	frame.triangles.push_back(index0);
+	frame.triangles.push_back(index1);
+	frame.triangles.push_back(index2);
+
+	// inclusive of the pixel right of / below the box, msaa samples can reach into it
+	int firstX, firstY, lastX, lastY;
+	m_pTiles->GetTileRange(left, bottom, right, top, firstX, firstY, lastX, lastY);
+
+	for (int ty{ firstY }; ty <= lastY; ++ty)
+	{
+		for (int tx{ firstX }; tx <= lastX; ++tx)
+		{
+			frame.bins[tx + ty * m_pTiles->GetTilesX()].push_back(triangle);
+		}
+	}
+}
+
+constexpr uint32_t SoftwareRenderer::GetCanonicalState(uint32_t state)
+{
+	// bounding boxes only write white and depth visualization never shades,
+	// drop the bits they ignore so equivalent states share one kernel
+	if (state & PipelineBoundingBox)
+	{
+		return state & (PipelineBoundingBox | PipelineMsaa);
+	}
+
+	if (state & PipelineDepthVisualization)
+	{
+		return state & (PipelineDepthVisualization | PipelineMsaa | PipelineReversedDepth);
+	}
+
+	// the transparent effect has no lighting
+	if (state & PipelineTransparentEffect)
+	{
+		return state & (PipelineTransparentEffect | PipelineMsaa | PipelineReversedDepth);
+	}
+
+	// extra lights & shadows are lit in world space
+	if (state & (PipelineLights | PipelineShadows))
+	{
+		return state & ~PipelineVertexTangentSpace;
+	}
+
+	return state;
+}
+
+template<uint32_t... States>
+constexpr SoftwareRenderer::PipelineTable SoftwareRenderer::MakePipelines(std::integer_sequence<uint32_t, States...>)
+{
+	return { &SoftwareRenderer::RenderTriangle<GetCanonicalState(States)>... };
+}
+
+const SoftwareRenderer::PipelineTable SoftwareRenderer::s_Pipelines =
+	MakePipelines(std::make_integer_sequence<uint32_t, PipelineStateCount>{});
+
+uint32_t SoftwareRenderer::GetPipelineState(const FrameData& frame) const
+{
+	uint32_t state = static_cast<uint32_t>(m_LightingMode) << PipelineLightingShift;
+
+	if (m_BoundingBoxVisualization) state |= PipelineBoundingBox;
+	if (m_DepthBufferVisualization) state |= PipelineDepthVisualization;
+	if (m_UseNormalMap) state |= PipelineNormalMap;
+	if (m_UseMsaa) state |= PipelineMsaa;
+	if (frame.isReversed) state |= PipelineReversedDepth;
+	if (frame.shaderContext.useVertexTangentSpace) state |= PipelineVertexTangentSpace;
+	if (!frame.lights.empty()) state |= PipelineLights;
+	if (frame.useShadows) state |= PipelineShadows;
+	if (frame.useFastMath) state |= PipelineFastMath;
+	if (frame.shaderProgram == ShaderProgram::TransparentEffect) state |= PipelineTransparentEffect;
+
+	return state;
+}
+
+template<uint32_t State>
+uint32_t SoftwareRenderer::RenderTriangle(const Mesh::Vertex_Out& v0, const Mesh::Vertex_Out& v1, const Mesh::Vertex_Out& v2, const ColorRGB& tint, int tileX, int tileY) const
+{
+	Vector2 edge0 = { v2.position.GetXY() - v1.position.GetXY() };
+	Vector2 edge1 = { v0.position.GetXY() - v2.position.GetXY() };
+	Vector2 edge2 = { v1.position.GetXY() - v0.position.GetXY() };
+
+	float area = Vector2::Cross(edge0, edge1);
+
+	if (area < 1.0f)
+	{
+		return 0;
+	}
+
+	auto top = std::max<float>(std::max<float>(v0.position.y, v1.position.y), v2.position.y);
+	auto bottom = std::min<float>(std::min<float>(v0.position.y, v1.position.y), v2.position.y);
+	auto left = std::min<float>(std::min<float>(v0.position.x, v1.position.x), v2.position.x);
+	auto right = std::max<float>(std::max<float>(v0.position.x, v1.position.x), v2.position.x);
+
+	// only the part of the bounding box inside this tile
+	int tileLeft, tileTop, tileRight, tileBottom;
+	m_pTiles->GetTileBounds(tileX, tileY, tileLeft, tileTop, tileRight, tileBottom);
+
+	using Shader = std::conditional_t<(State & PipelineTransparentEffect) != 0, TransparentEffectShader, EffectShader>;
+	constexpr uint32_t varyings = Shader::template GetVaryings<State>();
+
+	const std::vector<uint16_t>& tileLights = m_TileLights[tileX + tileY * m_pTiles->GetTilesX()];
+	const LightList lights{ tileLights.data(), tileLights.size() };
+
+	constexpr bool useMsaa = (State & PipelineMsaa) != 0;
+	constexpr bool isReversed = (State & PipelineReversedDepth) != 0;
+	constexpr bool useFastMath = (State & PipelineFastMath) != 0;
+	constexpr int sampleCount = useMsaa ? MsaaSampleCount : 1;
+
+	// samples sit up to 3/8 of a pixel off the pixel position, one more column & row can still be covered
+	constexpr int msaaMargin = useMsaa ? 1 : 0;
+
+	const int minX = std::max(static_cast<int>(left), tileLeft);
+	const int maxX = std::min(static_cast<int>(right) + msaaMargin, tileRight);
+	const int minY = std::max(static_cast<int>(bottom), tileTop);
+	const int maxY = std::min(static_cast<int>(top) + msaaMargin, tileBottom);
+
+	// coarse shading: one PixelShading call per rateX x rateY block, broadcast to every pixel of it that passes
+	// coverage & depth. blocks are aligned to the rate so neighbouring triangles share the same grid
+	int rateX, rateY;
+	GetTileShadingRate(tileX, tileY, rateX, rateY);
+
+	const int firstBlockX = minX - (minX % rateX);
+	const int firstBlockY = minY - (minY % rateY);
+
+	// with a prepass, coverage & depth come from the same setup the prepass rasterized this triangle with.
+	// both are then bit identical and only the fragments that won the prepass get shaded
+	const float* pPrepassDepth = Shader::DepthWrite ? m_pPrepassDepth : nullptr;
+	const size_t prepassPlaneSize = size_t(m_Width) * m_Height;
+	DepthRasterizer::TriangleSetup prepassSetups[sampleCount]{};
+
+	if (pPrepassDepth)
+	{
+		for (int sample{}; sample < sampleCount; ++sample)
+		{
+			const Vector2 offset = useMsaa ? MsaaSampleOffsets[sample] : Vector2{};
+
+			prepassSetups[sample].Initialize(
+				{ v0.position.x - offset.x, v0.position.y - offset.y, v0.position.z },
+				{ v1.position.x - offset.x, v1.position.y - offset.y, v1.position.z },
+				{ v2.position.x - offset.x, v2.position.y - offset.y, v2.position.z },
+				!isReversed);
+		}
+	}
+
+	uint32_t shadedSamples{};
+
+	for (int by{ firstBlockY }; by < maxY; by += rateY)
+	{
+		for (int bx{ firstBlockX }; bx < maxX; bx += rateX)
+		{
+			bool isShaded = false;
+			ShaderOutput blockOutput{};
+
+			for (int py{ std::max(by, minY) }; py < std::min(by + rateY, maxY); ++py)
+			{
+				for (int px{ std::max(bx, minX) }; px < std::min(bx + rateX, maxX); ++px)
+				{
+					const int pixelIndex = px + (py * m_Width);
+
+					if constexpr ((State & PipelineBoundingBox) != 0)
+					{
+						WritePixel(pixelIndex, sampleCount, (1u << sampleCount) - 1, PackColor(255, 255, 255));
+						shadedSamples += sampleCount;
+						continue;
+					}
+
+					// coverage & depth per sample, shading below happens once for all samples that passed.
+					// barycentrics & depth of the first passing sample are kept for shading, so they're never extrapolated
+					uint32_t sampleMask = 0;
+					float w0{}, w1{}, w2{};
+					float depthBuffer{};
+
+					for (int sample{}; sample < sampleCount; ++sample)
+					{
+						float sampleW0{}, sampleW1{}, sampleW2{};
+						float sampleDepth{};
+
+						if (pPrepassDepth)
+						{
+							if (!prepassSetups[sample].Evaluate(px, py, sampleW0, sampleW1, sampleW2, sampleDepth) ||
+								sampleDepth != pPrepassDepth[sample * prepassPlaneSize + pixelIndex])
+							{
+								continue;
+							}
+						}
+						else
+						{
+							Vector2 pixel{ static_cast<float>(px), static_cast<float>(py) };
+
+							if constexpr (useMsaa)
+							{
+								pixel += MsaaSampleOffsets[sample];
+							}
+
+							Vector2 p0ToPixel = pixel - v0.position.GetXY();
+							sampleW2 = Vector2::Cross(edge2, p0ToPixel) / area;
+
+							if (sampleW2 < 0.0f)
+							{
+								continue;
+							}
+
+							Vector2 p1ToPixel = pixel - v1.position.GetXY();
+							sampleW0 = Vector2::Cross(edge0, p1ToPixel) / area;
+
+							if (sampleW0 < 0.0f)
+							{
+								continue;
+							}
+
+							Vector2 p2ToPixel = pixel - v2.position.GetXY();
+							sampleW1 = Vector2::Cross(edge1, p2ToPixel) / area;
+
+							if (sampleW1 < 0.0f)
+							{
+								continue;
+							}
+
+							// Deoth Buffer
+							// reversed z is affine in screen space, so it can be interpolated linearly (and never divides by ~0 at the far plane)
+							if constexpr (isReversed)
+							{
+								sampleDepth = sampleW0 * v0.position.z + sampleW1 * v1.position.z + sampleW2 * v2.position.z;
+							}
+							else
+							{
+								sampleDepth = 1.f / (sampleW0 / v0.position.z + sampleW1 / v1.position.z + sampleW2 / v2.position.z);
+							}
+
+							// frustum culling z + depth test
+							if (sampleDepth < 0 || sampleDepth > 1)
+							{
+								continue;
+							}
+						}
+
+						if constexpr (Shader::DepthWrite)
+						{
+							if (!m_pDepthBuffer->TestAndWrite(pixelIndex * sampleCount + sample, sampleDepth))
+							{
+								continue;
+							}
+						}
+						else if (!m_pDepthBuffer->Test(pixelIndex * sampleCount + sample, sampleDepth))
+						{
+							continue;
+						}
+
+						if (!sampleMask)
+						{
+							w0 = sampleW0;
+							w1 = sampleW1;
+							w2 = sampleW2;
+							depthBuffer = sampleDepth;
+						}
+
+						sampleMask |= 1u << sample;
+					}
+
+					if (!sampleMask)
+					{
+						continue;
+					}
+
+					shadedSamples += std::popcount(sampleMask);
+
+					ShaderOutput output{};
+
+					if constexpr ((State & PipelineDepthVisualization) != 0)
+					{
+						// reversed depth is exactly 1 - forward depth
+						if constexpr (isReversed)
+						{
+							depthBuffer = 1.f - depthBuffer;
+						}
+
+						// Remap so it isnt too bright 
+						depthBuffer = (depthBuffer - 0.985f) / (1.0f - 0.985f);
+
+						depthBuffer = Clamp(depthBuffer, 0.f, 1.f);
+						output.color = { depthBuffer, depthBuffer, depthBuffer };
+					}
+					else if (isShaded)
+					{
+						output = blockOutput;
+					}
+					else
+					{
+						// actual depth
+						w0 /= v0.position.w;
+						w1 /= v1.position.w;
+						w2 /= v2.position.w;
+
+						auto depth = 1.0f / (w0 + w1 + w2);
+
+						// the first covered pixel of the block shades for all of it, with only the varyings the shader declared
+						Mesh::Vertex_Out shadingVertex{};
+						shadingVertex.position.x = (float)px;
+						shadingVertex.position.y = (float)py;
+
+						if constexpr ((varyings & VaryingColor) != 0)
+						{
+							shadingVertex.color = (w0 * v0.color + w1 * v1.color + w2 * v2.color) * depth;
+						}
+
+						if constexpr ((varyings & VaryingUv) != 0)
+						{
+							shadingVertex.uv = (w0 * v0.uv + w1 * v1.uv + w2 * v2.uv) * depth;
+						}
+
+						if constexpr ((varyings & VaryingNormal) != 0)
+						{
+							shadingVertex.normal = Normalized((w0 * v0.normal + w1 * v1.normal + w2 * v2.normal) * depth, useFastMath);
+						}
+
+						if constexpr ((varyings & VaryingTangent) != 0)
+						{
+							shadingVertex.tangent = Normalized((w0 * v0.tangent + w1 * v1.tangent + w2 * v2.tangent) * depth, useFastMath);
+						}
+
+						if constexpr ((varyings & VaryingWorldPosition) != 0)
+						{
+							shadingVertex.worldPosition = (w0 * v0.worldPosition + w1 * v1.worldPosition + w2 * v2.worldPosition) * depth;
+						}
+
+						if constexpr ((varyings & VaryingTangentSpace) != 0)
+						{
+							// left unnormalized, close enough across a triangle
+							shadingVertex.lightTangent = (w0 * v0.lightTangent + w1 * v1.lightTangent + w2 * v2.lightTangent) * depth;
+							shadingVertex.viewTangent = (w0 * v0.viewTangent + w1 * v1.viewTangent + w2 * v2.viewTangent) * depth;
+						}
+
+						output = Shader::template PixelStage<State>(m_pRasterFrame->shaderContext, lights, shadingVertex);
+						output.color *= tint;
+						blockOutput = output;
+						isShaded = true;
+					}
+
+					output.color.MaxToOne();
+
+					if constexpr (Shader::AlphaBlend && (State & PipelineDepthVisualization) == 0)
+					{
+						BlendPixel(pixelIndex, sampleCount, sampleMask, output.color, output.alpha);
+					}
+					else
+					{
+						WritePixel(pixelIndex, sampleCount, sampleMask, PackColor(
+							static_cast<uint8_t>(output.color.r * 255),
+							static_cast<uint8_t>(output.color.g * 255),
+							static_cast<uint8_t>(output.color.b * 255)));
+					}
+				}
+			}
+		}
+	}
+
+	return shadedSamples;
+}
+
+void SoftwareRenderer::GetTileShadingRate(int tileX, int tileY, int& rateX, int& rateY) const
+{
+	switch (m_ShadingRateMode)
+	{
+		case ShadingRateMode::Coarse2x1:
+			rateX = 2;
+			rateY = 1;
+			return;
+		case ShadingRateMode::Coarse1x2:
+			rateX = 1;
+			rateY = 2;
+			return;
+		case ShadingRateMode::Coarse2x2:
+			rateX = 2;
+			rateY = 2;
+			return;
+		case ShadingRateMode::Foveated:
+		{
+			// full rate around the center of the screen, coarser towards the edges
+			int left, top, right, bottom;
+			m_pTiles->GetTileBounds(tileX, tileY, left, top, right, bottom);
+
+			const float x = ((left + right) * 0.5f / m_Width - 0.5f) * 2.f;
+			const float y = ((top + bottom) * 0.5f / m_Height - 0.5f) * 2.f;
+			const float distance = sqrtf(x * x + y * y);
+
+			rateX = distance < 0.4f ? 1 : 2;
+			rateY = distance < 0.8f ? 1 : 2;
+			return;
+		}
+		case ShadingRateMode::Full:
+		default:
+			rateX = 1;
+			rateY = 1;
+			return;
+	}
+}
+
+void SoftwareRenderer::PrepareTile(int tileX, int tileY) const
+{
+	// lazily clear a tile the first time something gets drawn in it
+	TileGrid::Tile& tile = m_pTiles->GetTile(tileX, tileY);
+
+	if (tile.touched)
+	{
+		return;
+	}
+
+	ClearTile(tileX, tileY, !tile.colorCleared);
+	tile.touched = true;
+	tile.colorCleared = false;
+}
+
+void SoftwareRenderer::ClearTile(int tileX, int tileY, bool clearColor) const
+{
+	int left, top, right, bottom;
+	m_pTiles->GetTileBounds(tileX, tileY, left, top, right, bottom);
+
+	for (int py{ top }; py < bottom; ++py)
+	{
+		const int rowStart = left + py * m_Width;
+		const int rowEnd = right + py * m_Width;
+
+		// samples aren't tracked by the lazy clear, resolving overwrites the tile's pixels anyway
+		if (m_UseMsaa)
+		{
+			std::fill(m_pSamplePixels + rowStart * MsaaSampleCount, m_pSamplePixels + rowEnd * MsaaSampleCount, m_ClearColor);
+			m_pDepthBuffer->Clear(rowStart * MsaaSampleCount, rowEnd * MsaaSampleCount);
+			continue;
+		}
+
+		if (clearColor)
+		{
+			std::fill(m_pBackBufferPixels + rowStart, m_pBackBufferPixels + rowEnd, m_ClearColor);
+		}
+
+		m_pDepthBuffer->Clear(rowStart, rowEnd);
+	}
+}
+
+void SoftwareRenderer::ResolveTile(int tileX, int tileY) const
+{
+	int left, top, right, bottom;
+	m_pTiles->GetTileBounds(tileX, tileY, left, top, right, bottom);
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i rounding = _mm_set1_epi16(2);
+
+	for (int py{ top }; py < bottom; ++py)
+	{
+		for (int px{ left }; px < right; ++px)
+		{
+			const int pixel = px + py * m_Width;
+
+			// the 4 samples are one 16 byte load, widen to 16 bits per channel & add them up
+			const __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_pSamplePixels + pixel * MsaaSampleCount));
+			__m128i sum = _mm_add_epi16(_mm_unpacklo_epi8(samples, zero), _mm_unpackhi_epi8(samples, zero));
+			sum = _mm_add_epi16(sum, _mm_srli_si128(sum, 8));
+
+			const __m128i average = _mm_srli_epi16(_mm_add_epi16(sum, rounding), 2);
+			m_pBackBufferPixels[pixel] = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(average, average)));
+		}
+	}
+}
+
+void SoftwareRenderer::CullTileLights(const FrameData& frame, int tileX, int tileY, std::vector<uint16_t>& tileLights) const
+{
+	tileLights.clear();
+
+	if (frame.lights.empty())
+	{
+		return;
+	}
+
+	// depth bounds from the view depth (clip w) of the binned triangles. conservative, they can reach past the tile
+	const std::vector<uint32_t>& bin = frame.bins[tileX + tileY * m_pTiles->GetTilesX()];
+	float minDepth = FLT_MAX;
+	float maxDepth = 0.f;
+
+	for (uint32_t triangle : bin)
+	{
+		for (int corner{}; corner < 3; ++corner)
+		{
+			const float depth = frame.vertices[frame.triangles[triangle * 3 + corner]].position.w;
+			minDepth = std::min(minDepth, depth);
+			maxDepth = std::max(maxDepth, depth);
+		}
+	}
+
+	// tile edges as view space slopes (x / z, y / z), the side planes all go through the camera
+	int left, top, right, bottom;
+	m_pTiles->GetTileBounds(tileX, tileY, left, top, right, bottom);
+
+	const ShaderContext& context = frame.shaderContext;
+	const float slopeLeft = (2.f * left / m_Width - 1.f) * context.aspectRatio * context.fov;
+	const float slopeRight = (2.f * right / m_Width - 1.f) * context.aspectRatio * context.fov;
+	const float slopeTop = (1.f - 2.f * top / m_Height) * context.fov;
+	const float slopeBottom = (1.f - 2.f * bottom / m_Height) * context.fov;
+
+	const float scaleLeft = 1.f / sqrtf(1.f + slopeLeft * slopeLeft);
+	const float scaleRight = 1.f / sqrtf(1.f + slopeRight * slopeRight);
+	const float scaleTop = 1.f / sqrtf(1.f + slopeTop * slopeTop);
+	const float scaleBottom = 1.f / sqrtf(1.f + slopeBottom * slopeBottom);
+
+	for (size_t i{}; i < frame.lights.size(); ++i)
+	{
+		const Vector4& bounds = frame.lightBounds[i];
+		const float radius = bounds.w;
+
+		// directional
+		if (radius < 0.f)
+		{
+			tileLights.push_back(static_cast<uint16_t>(i));
+			continue;
+		}
+
+		// sphere against the depth range, then the signed distance to each side plane (positive inside)
+		if (bounds.z + radius < minDepth || bounds.z - radius > maxDepth ||
+			(bounds.x - slopeLeft * bounds.z) * scaleLeft < -radius ||
+			(slopeRight * bounds.z - bounds.x) * scaleRight < -radius ||
+			(slopeTop * bounds.z - bounds.y) * scaleTop < -radius ||
+			(bounds.y - slopeBottom * bounds.z) * scaleBottom < -radius)
+		{
+			continue;
+		}
+
+		tileLights.push_back(static_cast<uint16_t>(i));
+	}
+}
+
+void SoftwareRenderer::RenderDepthPrepass(const FrameData& frame, int tileX, int tileY) const
+{
+	int tileLeft, tileTop, tileRight, tileBottom;
+	m_pTiles->GetTileBounds(tileX, tileY, tileLeft, tileTop, tileRight, tileBottom);
+
+	const int sampleCount = m_UseMsaa ? MsaaSampleCount : 1;
+	const int msaaMargin = m_UseMsaa ? 1 : 0;
+	const size_t planeSize = size_t(m_Width) * m_Height;
+
+	// forward depth gets interpolated through its reciprocal by RenderTriangle, so the prepass does the same
+	DepthRasterizer rasterizers[MsaaSampleCount]{};
+
+	for (int sample{}; sample < sampleCount; ++sample)
+	{
+		float* pPlane = m_pPrepassDepth + sample * planeSize;
+		rasterizers[sample].SetTarget(pPlane, m_Width, m_Height, m_Width, frame.isReversed, !frame.isReversed);
+
+		for (int py{ tileTop }; py < tileBottom; ++py)
+		{
+			std::fill(pPlane + tileLeft + py * m_Width, pPlane + tileRight + py * m_Width, frame.isReversed ? 0.f : 1.f);
+		}
+	}
+
+	for (uint32_t triangle : frame.bins[tileX + tileY * m_pTiles->GetTilesX()])
+	{
+		const uint32_t* pIndices = &frame.triangles[triangle * 3];
+		const Vector4& p0 = frame.vertices[pIndices[0]].position;
+		const Vector4& p1 = frame.vertices[pIndices[1]].position;
+		const Vector4& p2 = frame.vertices[pIndices[2]].position;
+
+		// the same pixels RenderTriangle visits, the prepass must never cover more than the shading pass
+		const int minX = std::max(static_cast<int>(std::min(std::min(p0.x, p1.x), p2.x)), tileLeft);
+		const int maxX = std::min(static_cast<int>(std::max(std::max(p0.x, p1.x), p2.x)) + msaaMargin, tileRight);
+		const int minY = std::max(static_cast<int>(std::min(std::min(p0.y, p1.y), p2.y)), tileTop);
+		const int maxY = std::min(static_cast<int>(std::max(std::max(p0.y, p1.y), p2.y)) + msaaMargin, tileBottom);
+
+		for (int sample{}; sample < sampleCount; ++sample)
+		{
+			// moving the triangle against the sample offset puts the sample on the integer pixel position
+			const Vector2 offset = m_UseMsaa ? MsaaSampleOffsets[sample] : Vector2{};
+
+			rasterizers[sample].RasterizeTriangle(
+				{ p0.x - offset.x, p0.y - offset.y, p0.z },
+				{ p1.x - offset.x, p1.y - offset.y, p1.z },
+				{ p2.x - offset.x, p2.y - offset.y, p2.z },
+				minX, minY, maxX, maxY);
+		}
+	}
+}
+
+int SoftwareRenderer::CountCoveredSamples(int tileX, int tileY) const
+{
+	int left, top, right, bottom;
+	m_pTiles->GetTileBounds(tileX, tileY, left, top, right, bottom);
+
+	const int sampleCount = m_UseMsaa ? MsaaSampleCount : 1;
+	int coveredSamples{};
+
+	for (int py{ top }; py < bottom; ++py)
+	{
+		coveredSamples += m_pDepthBuffer->CountWritten((left + py * m_Width) * sampleCount, (right + py * m_Width) * sampleCount);
+	}
+
+	return coveredSamples;
+}
+
+void SoftwareRenderer::ResolveUntouchedTiles() const
+{
+	// nothing got drawn here this frame, but the tile might still hold last frame's pixels
+	for (int ty{}; ty < m_pTiles->GetTilesY(); ++ty)
+	{
+		for (int tx{}; tx < m_pTiles->GetTilesX(); ++tx)
+		{
+			TileGrid::Tile& tile = m_pTiles->GetTile(tx, ty);
+
+			if (tile.touched || tile.colorCleared || !IsTileDirty(tx + ty * m_pTiles->GetTilesX()))
+			{
+				continue;
+			}
+
+			int left, top, right, bottom;
+			m_pTiles->GetTileBounds(tx, ty, left, top, right, bottom);
+
+			for (int py{ top }; py < bottom; ++py)
+			{
+				std::fill(m_pBackBufferPixels + left + py * m_Width, m_pBackBufferPixels + right + py * m_Width, m_ClearColor);
+			}
+
+			tile.colorCleared = true;
+		}
+	}
 }
@@ -1,7 +1,15 @@
 #pragma once
 
+#include <array>
+#include <utility>
+
 #include "Mesh.h"
 #include "Camera.h"
+#include "TileGrid.h"
+#include "DepthBuffer.h"
+#include "FrameOutput.h"
+#include "SoftwareShader.h"
+#include "OcclusionBuffer.h"
 
 struct SDL_Window;
 struct SDL_Surface;
@@ -19,44 +27,171 @@ namespace dae
 		SoftwareRenderer& operator=(const SoftwareRenderer&) = delete;
 		SoftwareRenderer& operator=(SoftwareRenderer&&) noexcept = delete;
 
+		// one copy of a mesh, with its own transform & a tint multiplied into the shaded color
+		struct Instance
+		{
+			Matrix worldMatrix{};
+			ColorRGB tint{ 1.f, 1.f, 1.f };
+		};
+
 		void Render(const std::vector<Mesh*>& meshes);
+		// every instance shares the mesh's vertex data & gets binned into the same tiles
+		void RenderInstanced(Mesh* pMesh, const std::vector<Instance>& instances);
 		void SetTextures(Texture* pTexture, Texture* pNormal, Texture* pGloss, Texture* pSpecular);
+		// CPU counterpart of the mesh's effect, see BaseEffect::GetSoftwareShader
+		void SetShaderProgram(ShaderProgram shaderProgram) { m_ShaderProgram = shaderProgram; InvalidateFrame(); };
+		// on top of the directional light, culled per tile every frame
+		void SetLights(const std::vector<Light>& lights) { m_Lights = lights; InvalidateFrame(); };
+		// instances & meshlets hidden in it get dropped before their vertices are transformed, null turns that off.
+		// has to stay untouched during Render
+		void SetOcclusionBuffer(const OcclusionBuffer* pOcclusion) { m_pOcclusion = pOcclusion; InvalidateFrame(); };
 
-		void SetUniformColor(bool useUniformColor) { m_UseUniformColor = useUniformColor; };
-		void SetCullingMode(Mesh::CullMode cullMode) { m_CullMode = cullMode; };
+		// every instance picks its own level of detail, the same way the renderer does for whole meshes
+		void SetLodScreenRadius(float lodScreenRadius) { m_LodScreenRadius = lodScreenRadius; InvalidateFrame(); };
 
-		bool SaveBufferToImage() const;
+		void SetUniformColor(bool useUniformColor) { m_UseUniformColor = useUniformColor; InvalidateFrame(); };
+		void SetCullingMode(Mesh::CullMode cullMode) { m_CullMode = cullMode; InvalidateFrame(); };
+
+		// the next frame gets rendered in full, for anything that changes the image without the renderer noticing
+		void InvalidateFrame() { ++m_SettingsVersion; };
+		// the last Render found nothing that changed, the window still shows the previous frame
+		bool IsIdle() const { return m_IsIdle; };
+		// samples the shading pass wrote per sample that ended up covered, over the tiles the last rasterized frame redrew. 0 while the counter is off
+		float GetOverdraw() const { return m_CoveredSamples ? float(m_ShadedSamples) / m_CoveredSamples : 0.f; };
+		bool IsCountingOverdraw() const { return m_CountOverdraw; };
+
+		bool SaveBufferToImage();
 		void ToggleDepthBufferVisualization();
 		void ToggleNormalMap();
 		void CycleLightingMode();
 		void ToggleBoundingBoxVisualization();
+		void CycleDepthFormat();
+		void TogglePipelinedFrames();
+		void ToggleAsyncOutput();
+		void ToggleMeshletCulling();
+		void ToggleDynamicResolution();
+		void CycleShadingRate();
+		void ToggleMsaa();
+		void ToggleDirtyTracking();
+		void ToggleVertexTangentSpace();
+		void ToggleFastMath();
+		void CycleShaderProgram();
+		void CycleShadowMode();
+		void ToggleDepthPrepass();
+		void ToggleOverdrawCounter();
+
+		// moves the internal resolution towards the frame time budget, only while dynamic resolution is on
+		void UpdateResolutionScale(const Timer* pTimer);
 
 	private:
 		Camera* m_pCamera;
 		SDL_Window* m_pWindow{};
+		// size frames get rendered at, only differs from the window's size with dynamic resolution
 		int m_Width{};
 		int m_Height{};
+		int m_OutputWidth{};
+		int m_OutputHeight{};
 
 		SDL_Surface* m_pFrontBuffer{ nullptr };
 		SDL_Surface* m_pBackBuffer{ nullptr };
 		uint32_t* m_pBackBufferPixels{};
-		float* m_pDepthBufferPixels{};
+		DepthBuffer* m_pDepthBuffer{ nullptr };
+
+		uint32_t m_RedShift{};
+		uint32_t m_GreenShift{};
+		uint32_t m_BlueShift{};
+		uint32_t m_AlphaMask{};
+		uint32_t m_ClearColor{};
+
+		TileGrid* m_pTiles{ nullptr };
+
+		FrameOutput* m_pOutput{ nullptr };
+		bool m_AsyncOutput = false;
+
+		// dynamic resolution renders into m_ScaledPixels, which gets upscaled into the output afterwards
+		bool m_UseDynamicResolution = false;
+		float m_TargetFrameTime{ 1.f / 60.f };
+		float m_MinResolutionScale{ 0.5f };
+		float m_ResolutionScale{ 1.f };
+		std::vector<uint32_t> m_ScaledPixels;
+		// source column of every output column
+		std::vector<int> m_UpscaleColumns;
+
+		// 4x msaa: coverage & depth per sample, shading once per pixel, samples of a pixel next to each other.
+		// only touched tiles have valid samples, they get resolved into the render target right after rasterizing
+		static constexpr int MsaaSampleCount = 4;
+		bool m_UseMsaa = false;
+		std::vector<uint32_t> m_SamplePixels;
+		uint32_t* m_pSamplePixels{ nullptr };
+
+		// dirty tracking: what the last rendered frame was built from, to skip identical frames
+		// or only redraw the tiles covered by instances that moved
+		bool m_UseDirtyTracking = true;
+		bool m_IsIdle = false;
+		uint32_t m_SettingsVersion{};
+		uint32_t m_RenderedSettingsVersion{ UINT32_MAX };
+		uint32_t m_RenderedCameraVersion{};
+		const Mesh* m_pRenderedMesh{ nullptr };
+		std::vector<Instance> m_RenderedInstances;
+		// empty when the whole frame is dirty
+		std::vector<bool> m_DirtyTiles;
 
-		enum class LightingMode
+		// projected bounding sphere radius in pixels below which an instance uses the next level of detail
+		float m_LodScreenRadius{ 200.f };
+
+		// pixels per PixelShading call, per frame or per tile (foveated)
+		enum class ShadingRateMode
 		{
-			ObservedArea,
-			Diffuse,
-			Specular,
-			Combined,
+			Full,
+			Coarse2x1,
+			Coarse1x2,
+			Coarse2x2,
+			Foveated,
 			End
 		};
 
+		ShaderProgram m_ShaderProgram{ ShaderProgram::Effect };
+		std::vector<Light> m_Lights;
+		const OcclusionBuffer* m_pOcclusion{ nullptr };
+		// per tile, the lights whose bounds overlap the tile's screen area & depth range. written by the tile's worker
+		std::vector<std::vector<uint16_t>> m_TileLights;
 		LightingMode m_LightingMode{ LightingMode::Combined };
+		ShadingRateMode m_ShadingRateMode{ ShadingRateMode::Full };
+
+		// directional light shadows, rendered each frame by the depth only rasterizer
+		enum class ShadowMode
+		{
+			Off,
+			Hard,
+			Pcf,
+			End
+		};
+
+		static constexpr int ShadowMapSize = 1024;
+		// rows of the shadow map per job
+		static constexpr int ShadowBandHeight = 64;
+		ShadowMode m_ShadowMode{ ShadowMode::Off };
+
+		// depth prepass: each tile's depth is laid down by the depth only rasterizer before its triangles get shaded,
+		// the shading pass then only lets through fragments at the prepass depth. opaque shaders only
+		bool m_UseDepthPrepass = false;
+		// one plane of width x height per sample, in the depth buffer's direction
+		std::vector<float> m_PrepassDepth;
+		// null when this frame has no prepass
+		float* m_pPrepassDepth{ nullptr };
+		// overdraw counter, see GetOverdraw. covered samples cost a scan of each redrawn tile's depth, so only while it's shown
+		bool m_CountOverdraw = false;
+		uint64_t m_ShadedSamples{};
+		uint64_t m_CoveredSamples{};
 		bool m_BoundingBoxVisualization = false;
 		bool m_DepthBufferVisualization = false;
 		bool m_RotateMesh = false;
 		float m_MeshRotation = 0.0f;
 		bool m_UseNormalMap = true;
+		// light & view vectors go to tangent space per vertex, instead of building the tangent frame per pixel
+		bool m_UseVertexTangentSpace = false;
+		// approximate pow & normalization in the shader, for previews
+		bool m_UseFastMath = false;
 		bool m_UseUniformColor = false;
 		Mesh::CullMode m_CullMode = Mesh::CullMode::Back;
 
@@ -65,12 +200,163 @@ namespace dae
 		Texture* m_pGloss = nullptr;
 		Texture* m_pSpecular = nullptr;
 
-		void VertexTransformationFunction(Mesh* mesh, std::vector<Mesh::Vertex_Out>& verticesOut) const;
+		struct InstanceData
+		{
+			Matrix worldMatrix{};
+			Matrix worldViewProjection{};
+			ColorRGB tint{};
+			// where this instance's copy of the vertices starts in FrameData::vertices
+			uint32_t vertexOffset{};
+			// picked from its projected bounding sphere, only the vertices this level uses get transformed
+			int lod{};
+		};
+
+		struct FrameData
+		{
+			// snapshot of the frame's state, taken before geometry processing starts
+			// only the instances that survived frustum culling
+			std::vector<InstanceData> instances;
+			uint32_t meshVertexCount{};
+			uint32_t culledInstances{};
+			Vector3 cameraOrigin{};
+			ShaderProgram shaderProgram{};
+			ShaderContext shaderContext{};
+			bool isReversed = false;
+			bool useFastMath = false;
+			bool useMeshlets = false;
+			bool cullBackfacingMeshlets = false;
+			// decided at capture, the shadow map itself only exists once the geometry stage rendered it
+			bool useShadows = false;
+			const OcclusionBuffer* pOcclusion{ nullptr };
+			bool isValid = false;
+			uint32_t culledMeshlets{};
+
+			// meshVertexCount per visible instance
+			std::vector<Mesh::Vertex_Out> vertices;
+			// 3 vertex indices per triangle, only the ones that survived culling
+			std::vector<uint32_t> triangles;
+			// per tile, the triangles overlapping it
+			std::vector<std::vector<uint32_t>> bins;
+			// view space bounding sphere per light, a negative radius reaches everything
+			std::vector<Light> lights;
+			std::vector<Vector4> lightBounds;
 
-		void RenderTriangle(const Mesh::Vertex_Out& v0, const Mesh::Vertex_Out& v1, const Mesh::Vertex_Out& v2) const;
-		void RenderMesh(Mesh* mesh, std::vector<Mesh::Vertex_Out>& vertices) const;
+			std::vector<float> shadowMap;
+			// shadow map texel & depth per vertex per visible instance
+			std::vector<Vector3> shadowVertices;
+			// per band of ShadowBandHeight rows, 3 shadowVertices indices per triangle overlapping it
+			std::vector<std::vector<uint32_t>> shadowBands;
+		};
+
+		// double buffered so geometry of one frame can be processed while the other gets rasterized
+		FrameData m_Frames[2];
+		int m_FrameIndex = 0;
+		bool m_PipelineFrames = false;
+		bool m_UseMeshletCulling = true;
+		const FrameData* m_pRasterFrame{ nullptr };
+
+		// Render draws the mesh's own transform as a single instance
+		std::vector<Instance> m_SingleInstance{ 1 };
+
+		void CaptureFrame(FrameData& frame, Mesh* mesh, const std::vector<Instance>& instances) const;
+		void ProcessGeometry(FrameData& frame, Mesh* mesh) const;
+		void RenderShadowMap(FrameData& frame, Mesh* mesh) const;
+		void RasterizeFrame(const FrameData& frame);
+
+		void VertexTransformationFunction(FrameData& frame, Mesh* mesh) const;
+		// job(instance, pIndices, count) in parallel over the vertices of every instance's level of detail, in ranges of up to 2048
+		template<typename Job>
+		void ForEachLodVertex(const FrameData& frame, Mesh* mesh, bool skipMeshletInstances, const Job& job) const;
+		void TransformVertices(const FrameData& frame, const InstanceData& instance, const Mesh::Vertex_In* pVerticesIn, const uint32_t* pIndices, size_t count, Mesh::Vertex_Out* pVerticesOut) const;
+		template<typename Shader>
+		void TransformVertices(const FrameData& frame, const InstanceData& instance, const Mesh::Vertex_In* pVerticesIn, const uint32_t* pIndices, size_t count, Mesh::Vertex_Out* pVerticesOut) const;
+		void ProcessMeshlets(FrameData& frame, Mesh* mesh, const InstanceData& instance) const;
+		void ResetBins(FrameData& frame) const;
+		void BinTriangles(FrameData& frame, Mesh* mesh, const InstanceData& instance) const;
+		void BinTriangle(FrameData& frame, uint32_t index0, uint32_t index1, uint32_t index2) const;
+
+		// one raster & shading kernel per PipelineState, RasterizeFrame picks it once per frame from s_Pipelines.
+		// returns the samples it wrote, for the overdraw counter
+		using TrianglePipeline = uint32_t (SoftwareRenderer::*)(const Mesh::Vertex_Out&, const Mesh::Vertex_Out&, const Mesh::Vertex_Out&, const ColorRGB&, int, int) const;
+		using PipelineTable = std::array<TrianglePipeline, PipelineStateCount>;
+		static const PipelineTable s_Pipelines;
+
+		template<uint32_t... States>
+		static constexpr PipelineTable MakePipelines(std::integer_sequence<uint32_t, States...>);
+		static constexpr uint32_t GetCanonicalState(uint32_t state);
+		uint32_t GetPipelineState(const FrameData& frame) const;
+
+		template<uint32_t State>
+		uint32_t RenderTriangle(const Mesh::Vertex_Out& v0, const Mesh::Vertex_Out& v1, const Mesh::Vertex_Out& v2, const ColorRGB& tint, int tileX, int tileY) const;
+		void GetTileShadingRate(int tileX, int tileY, int& rateX, int& rateY) const;
+		void PrepareTile(int tileX, int tileY) const;
+		void ClearTile(int tileX, int tileY, bool clearColor) const;
+		void ResolveUntouchedTiles() const;
+		void ResolveTile(int tileX, int tileY) const;
+		void CullTileLights(const FrameData& frame, int tileX, int tileY, std::vector<uint16_t>& tileLights) const;
+		void RenderDepthPrepass(const FrameData& frame, int tileX, int tileY) const;
+		int CountCoveredSamples(int tileX, int tileY) const;
+
+		bool UpdateDirtyTiles(Mesh* pMesh, const std::vector<Instance>& instances);
+		void MarkDirtyTiles(Mesh* pMesh, const Matrix& worldViewProjection);
+		bool IsTileDirty(int tileIndex) const { return m_DirtyTiles.empty() || m_DirtyTiles[tileIndex]; };
+
+		void ResizeBuffers(int width, int height);
+		void Upscale(SDL_Surface* pTarget) const;
+
+		// straight into the render target, or into the samples in sampleMask with msaa
+		void WritePixel(int pixelIndex, int sampleCount, uint32_t sampleMask, uint32_t color) const
+		{
+			if (sampleCount == 1)
+			{
+				m_pBackBufferPixels[pixelIndex] = color;
+				return;
+			}
+
+			uint32_t* pSamples = m_pSamplePixels + pixelIndex * sampleCount;
+
+			for (int sample{}; sample < sampleCount; ++sample)
+			{
+				if (sampleMask & (1u << sample))
+				{
+					pSamples[sample] = color;
+				}
+			}
+		};
+
+		// src_alpha / inv_src_alpha over whatever the samples in sampleMask hold
+		void BlendPixel(int pixelIndex, int sampleCount, uint32_t sampleMask, const ColorRGB& color, float alpha) const
+		{
+			uint32_t* pSamples = sampleCount == 1 ? m_pBackBufferPixels + pixelIndex : m_pSamplePixels + pixelIndex * sampleCount;
+
+			for (int sample{}; sample < sampleCount; ++sample)
+			{
+				if (sampleMask & (1u << sample))
+				{
+					ColorRGB blended = color * alpha + UnpackColor(pSamples[sample]) * (1.f - alpha);
+					blended.MaxToOne();
+
+					pSamples[sample] = PackColor(
+						static_cast<uint8_t>(blended.r * 255),
+						static_cast<uint8_t>(blended.g * 255),
+						static_cast<uint8_t>(blended.b * 255));
+				}
+			}
+		};
+
+		uint32_t PackColor(uint8_t r, uint8_t g, uint8_t b) const
+		{
+			return (uint32_t(r) << m_RedShift) | (uint32_t(g) << m_GreenShift) | (uint32_t(b) << m_BlueShift) | m_AlphaMask;
+		};
+
+		ColorRGB UnpackColor(uint32_t color) const
+		{
+			return {
+				((color >> m_RedShift) & 255) / 255.f,
+				((color >> m_GreenShift) & 255) / 255.f,
+				((color >> m_BlueShift) & 255) / 255.f };
+		};
 
-		ColorRGB PixelShading(const Mesh::Vertex_Out& v) const;
-		ColorRGB Phong(ColorRGB specular, float gloss, Vector3 lightDir, Vector3 viewDir, Vector3 normal) const;
+		void ReportFastMathError() const;
 	};
 }
@@ -0,0 +1,396 @@
+#pragma once
+#include <cstdint>
+#include "Mesh.h"
+#include "Texture.h"
+
+namespace dae
+{
+	// CPU counterparts of the .fx effects, picked per frame by the software renderer.
+	// a shader declares the vertex outputs its vertex stage needs and the varyings its pixel stage reads,
+	// the rasterizer only transforms & interpolates those
+	enum class ShaderProgram
+	{
+		Effect,
+		TransparentEffect,
+		End
+	};
+
+	enum ShaderVarying : uint32_t
+	{
+		VaryingColor = 1 << 0,
+		VaryingUv = 1 << 1,
+		VaryingNormal = 1 << 2,
+		VaryingTangent = 1 << 3,
+		// lightTangent & viewTangent
+		VaryingTangentSpace = 1 << 4,
+		VaryingWorldPosition = 1 << 5
+	};
+
+	enum class LightingMode
+	{
+		ObservedArea,
+		Diffuse,
+		Specular,
+		Combined,
+		End
+	};
+
+	// every render state the raster & shading loops branch on, baked into its own kernel
+	enum PipelineState : uint32_t
+	{
+		PipelineBoundingBox = 1 << 0,
+		PipelineDepthVisualization = 1 << 1,
+		PipelineNormalMap = 1 << 2,
+		PipelineMsaa = 1 << 3,
+		PipelineReversedDepth = 1 << 4,
+		PipelineVertexTangentSpace = 1 << 5,
+		PipelineFastMath = 1 << 6,
+		// LightingMode in 2 bits
+		PipelineLightingShift = 7,
+		PipelineLightingMask = 3 << PipelineLightingShift,
+		PipelineTransparentEffect = 1 << 9,
+		PipelineLights = 1 << 10,
+		PipelineShadows = 1 << 11,
+		PipelineStateCount = 1 << 12
+	};
+
+	// extra lights on top of the directional light every shader has, in world space
+	struct Light
+	{
+		enum class Type
+		{
+			Directional,
+			Point,
+			Spot
+		};
+
+		Type type{ Type::Point };
+		Vector3 position{};
+		// directional & spot, pointing away from the light
+		Vector3 direction{ 0.f, -1.f, 0.f };
+		ColorRGB color{ 1.f, 1.f, 1.f };
+		float intensity{ 1.f };
+		// point & spot, fades out to nothing at this distance
+		float range{ 10.f };
+		// spot, cosines of the half angles where the falloff starts & ends
+		float innerCone{ 0.95f };
+		float outerCone{ 0.85f };
+	};
+
+	// normalized direction towards the light & how much of it reaches position, false when none does
+	inline bool EvaluateLight(const Light& light, const Vector3& position, Vector3& toLight, float& attenuation)
+	{
+		if (light.type == Light::Type::Directional)
+		{
+			toLight = -light.direction;
+			attenuation = 1.f;
+			return true;
+		}
+
+		toLight = light.position - position;
+		const float distanceSquared = toLight * toLight;
+
+		if (distanceSquared >= light.range * light.range)
+		{
+			return false;
+		}
+
+		const float distance = sqrtf(distanceSquared);
+		toLight *= 1.f / distance;
+		attenuation = Square(1.f - distance / light.range);
+
+		if (light.type == Light::Type::Spot)
+		{
+			const float cone = -(toLight * light.direction);
+
+			if (cone <= light.outerCone)
+			{
+				return false;
+			}
+
+			attenuation *= Saturate((cone - light.outerCone) / (light.innerCone - light.outerCone));
+		}
+
+		return true;
+	}
+
+	// indices into ShaderContext::pLights of the lights that reach a tile
+	struct LightList
+	{
+		const uint16_t* pIndices = nullptr;
+		size_t count{};
+	};
+
+	// per frame shader constants, the globals of the .fx files
+	struct ShaderContext
+	{
+		Texture* pDiffuse = nullptr;
+		Texture* pNormal = nullptr;
+		Texture* pGloss = nullptr;
+		Texture* pSpecular = nullptr;
+
+		Vector3 lightDirection{ .577f, -.577f, .577f };
+		Vector3 cameraOrigin{};
+		Vector3 cameraForward{};
+		Vector3 cameraRight{};
+		Vector3 cameraUp{};
+		float fov{};
+		float aspectRatio{};
+		int width{};
+		int height{};
+
+		bool useVertexTangentSpace = false;
+		const Light* pLights = nullptr;
+
+		// directional light shadow map, depth along the light in [0, 1], smaller is closer
+		const float* pShadowMap = nullptr;
+		int shadowMapSize{};
+		// world position to shadow map texel (x, y) & depth (z)
+		Matrix worldToShadow{};
+		float shadowBias{};
+		// 0 for a single tap, 1 for 3x3 pcf
+		int shadowFilterRadius{};
+	};
+
+	// fraction of the directional light reaching position, 1 outside the shadow map
+	inline float SampleShadow(const ShaderContext& context, const Vector3& position)
+	{
+		const Vector3 shadow = context.worldToShadow.TransformPoint(position);
+		const int size = context.shadowMapSize;
+		const int centerX = static_cast<int>(shadow.x);
+		const int centerY = static_cast<int>(shadow.y);
+
+		if (shadow.x < 0.f || shadow.y < 0.f || centerX >= size || centerY >= size)
+		{
+			return 1.f;
+		}
+
+		const float depth = shadow.z - context.shadowBias;
+		const int radius = context.shadowFilterRadius;
+		int lit{};
+
+		for (int y{ centerY - radius }; y <= centerY + radius; ++y)
+		{
+			const int row = Clamp(y, 0, size - 1) * size;
+
+			for (int x{ centerX - radius }; x <= centerX + radius; ++x)
+			{
+				lit += depth <= context.pShadowMap[row + Clamp(x, 0, size - 1)];
+			}
+		}
+
+		const int taps = (2 * radius + 1) * (2 * radius + 1);
+		return static_cast<float>(lit) / taps;
+	}
+
+	struct ShaderOutput
+	{
+		ColorRGB color{};
+		float alpha{ 1.f };
+	};
+
+	inline Vector3 Normalized(const Vector3& v, bool useFastMath)
+	{
+		return useFastMath ? v * FastInvSqrt(v * v) : v.Normalized();
+	}
+
+	// PosCol3D.fx
+	struct EffectShader
+	{
+		static constexpr uint32_t VertexOutputs = VaryingUv | VaryingNormal | VaryingTangent | VaryingWorldPosition;
+		static constexpr bool DepthWrite = true;
+		static constexpr bool AlphaBlend = false;
+
+		static constexpr float LightIntensity = 7.f;
+		static constexpr float Shininess = 25.f;
+
+		// with per-vertex tangent space, the interpolated normal & tangent aren't read anymore.
+		// extra lights & shadows are looked up in world space, they never use per-vertex tangent space
+		template<uint32_t State>
+		static constexpr uint32_t GetVaryings()
+		{
+			if constexpr ((State & (PipelineLights | PipelineShadows)) != 0)
+			{
+				return VaryingUv | VaryingNormal | VaryingTangent | VaryingWorldPosition;
+			}
+			else if constexpr ((State & PipelineVertexTangentSpace) != 0)
+			{
+				return VaryingUv | VaryingTangentSpace;
+			}
+
+			return VaryingUv | VaryingNormal | VaryingTangent;
+		}
+
+		static void VertexStage(const ShaderContext& context, const Mesh::Vertex_In& vertexIn, const Matrix& world, Mesh::Vertex_Out& v)
+		{
+			if (!context.useVertexTangentSpace)
+			{
+				return;
+			}
+
+			// project onto the tangent frame here, so pixels only need dot products with the sampled normal
+			const Vector3 binormal = Vector3::Cross(v.normal, v.tangent);
+			const Vector3 toLight = -context.lightDirection;
+			const Vector3 viewDirection = (world.TransformPoint(vertexIn.position) - context.cameraOrigin).Normalized();
+
+			v.lightTangent = { toLight * v.tangent, toLight * binormal, toLight * v.normal };
+			v.viewTangent = { viewDirection * v.tangent, viewDirection * binormal, viewDirection * v.normal };
+		}
+
+		template<uint32_t State>
+		static ShaderOutput PixelStage(const ShaderContext& context, const LightList& lights, const Mesh::Vertex_Out& v)
+		{
+			constexpr bool useFastMath = (State & PipelineFastMath) != 0;
+			constexpr auto lightingMode = static_cast<LightingMode>((State & PipelineLightingMask) >> PipelineLightingShift);
+
+			Vector3 normal{ v.normal };
+			Vector3 toLight{ -context.lightDirection };
+			Vector3 viewDirection{};
+
+			if constexpr ((State & PipelineVertexTangentSpace) != 0)
+			{
+				// light & view were moved to tangent space per vertex, the sampled normal can be used as is
+				toLight = v.lightTangent;
+				viewDirection = v.viewTangent;
+				normal = Vector3::UnitZ;
+
+				if constexpr ((State & PipelineNormalMap) != 0)
+				{
+					// sample and remap color to [-1, 1]
+					ColorRGB sampledColor = context.pNormal->Sample(v.uv);
+					sampledColor = (2.f * sampledColor) - ColorRGB{ 1.f, 1.f, 1.f };
+
+					normal = { sampledColor.r, sampledColor.g, sampledColor.b };
+				}
+			}
+			else
+			{
+				// Create viewDirection
+				float x = (2 * (v.position.x + 0.5f / float(context.width)) - 1) * context.aspectRatio * context.fov;
+				float y = (1 - (2 * (v.position.y + 0.5f / float(context.height)))) * context.fov;
+
+				viewDirection = Normalized(x * context.cameraRight + y * context.cameraUp + context.cameraForward, useFastMath);
+
+				if constexpr ((State & PipelineNormalMap) != 0)
+				{
+					// Create tangent space transformation matrix
+					Vector3 binormal = Vector3::Cross(v.normal, v.tangent);
+					Matrix tangentSpaceAxis{ v.tangent, binormal, v.normal, Vector3::Zero };
+
+					// sample and remap color to [-1, 1]
+					ColorRGB sampledColor = context.pNormal->Sample(v.uv);
+					sampledColor = (2.f * sampledColor) - ColorRGB{ 1.f, 1.f, 1.f };
+
+					normal = tangentSpaceAxis.TransformVector(sampledColor.r, sampledColor.g, sampledColor.b);
+				}
+			}
+
+			// textures get sampled once, no matter how many lights there are
+			ColorRGB diffuse{};
+			ColorRGB specular{};
+			float gloss{};
+
+			if constexpr (lightingMode == LightingMode::Diffuse || lightingMode == LightingMode::Combined)
+			{
+				diffuse = context.pDiffuse->Sample(v.uv);
+			}
+
+			if constexpr (lightingMode == LightingMode::Specular || lightingMode == LightingMode::Combined)
+			{
+				specular = context.pSpecular->Sample(v.uv);
+				gloss = Shininess * context.pGloss->Sample(v.uv).r;
+			}
+
+			ColorRGB finalColor = ShadeLight<lightingMode, useFastMath>(diffuse, specular, gloss, toLight, viewDirection, normal);
+
+			if constexpr ((State & PipelineShadows) != 0)
+			{
+				finalColor *= SampleShadow(context, v.worldPosition);
+			}
+
+			if constexpr ((State & PipelineLights) != 0)
+			{
+				for (size_t i{}; i < lights.count; ++i)
+				{
+					const Light& light = context.pLights[lights.pIndices[i]];
+					Vector3 lightDirection;
+					float attenuation;
+
+					if (EvaluateLight(light, v.worldPosition, lightDirection, attenuation))
+					{
+						finalColor += ShadeLight<lightingMode, useFastMath>(diffuse, specular, gloss, lightDirection, viewDirection, normal) * light.color * (light.intensity * attenuation);
+					}
+				}
+			}
+
+			finalColor.MaxToOne();
+			return { finalColor };
+		}
+
+		template<LightingMode lightingMode, bool useFastMath>
+		static ColorRGB ShadeLight(const ColorRGB& diffuse, const ColorRGB& specular, float gloss, const Vector3& toLight, const Vector3& viewDirection, const Vector3& normal)
+		{
+			float dot = normal * toLight;
+
+			if (dot < 0.f)
+			{
+				return {};
+			}
+
+			if constexpr (lightingMode == LightingMode::ObservedArea)
+			{
+				return { dot, dot, dot };
+			}
+			else if constexpr (lightingMode == LightingMode::Diffuse)
+			{
+				return diffuse * dot * LightIntensity / M_PI;
+			}
+			else if constexpr (lightingMode == LightingMode::Specular)
+			{
+				return Phong(specular, gloss, toLight, viewDirection, normal, useFastMath) * dot;
+			}
+			else
+			{
+				return diffuse * dot * LightIntensity / M_PI + Phong(specular, gloss, toLight, viewDirection, normal, useFastMath) * dot;
+			}
+		}
+
+		static ColorRGB Phong(ColorRGB specular, float gloss, Vector3 lightDir, Vector3 viewDir, Vector3 normal, bool useFastMath)
+		{
+			auto dot = (lightDir - (normal * (2.f * (normal * lightDir)))) * viewDir;
+
+			if (dot < 0.f)
+			{
+				return {};
+			}
+
+			return specular * (useFastMath ? FastPow(dot, gloss) : powf(dot, gloss));
+		}
+	};
+
+	// Transparent3D.fx: unlit diffuse, alpha blended over what's already there, no depth writes
+	struct TransparentEffectShader
+	{
+		static constexpr uint32_t VertexOutputs = VaryingUv;
+		static constexpr bool DepthWrite = false;
+		static constexpr bool AlphaBlend = true;
+
+		template<uint32_t State>
+		static constexpr uint32_t GetVaryings()
+		{
+			return VaryingUv;
+		}
+
+		static void VertexStage(const ShaderContext&, const Mesh::Vertex_In&, const Matrix&, Mesh::Vertex_Out&)
+		{
+		}
+
+		template<uint32_t State>
+		static ShaderOutput PixelStage(const ShaderContext& context, const LightList&, const Mesh::Vertex_Out& v)
+		{
+			ShaderOutput output{};
+			output.color = context.pDiffuse->Sample(v.uv, output.alpha);
+			return output;
+		}
+	};
+}
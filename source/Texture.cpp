@@ -2,31 +2,110 @@
 #include "Texture.h"
 #include "Vector2.h"
 #include <SDL_image.h>
+#include "JobSystem.h"
+#include <cstring>
 #include <d3d11.h>
 
 namespace dae
 {
-	Texture::Texture(ID3D11Device* pDevice, SDL_Surface* pSurface)
-		: m_pSurface(pSurface), m_pSurfacePixels(static_cast<uint32_t*>(pSurface->pixels))
+	namespace
+	{
+		std::atomic<uint32_t> s_NextTextureId{ 1 };
+
+		// blocks the calling thread decoded last. a group of 16 per texture (the shader samples several at the same uv),
+		// direct mapped on the block's position so neighbouring blocks don't evict each other.
+		// ids are handed out in load order, so the first DecodedBlockGroups textures never share a group
+		struct DecodedBlock
+		{
+			uint32_t textureId{};
+			uint32_t blockIndex{};
+			uint32_t texels[BlockCompression::BlockTexels]{};
+		};
+
+		constexpr int DecodedBlockGroups = 8;
+		thread_local DecodedBlock s_DecodedBlocks[DecodedBlockGroups * 16];
+	}
+
+	Texture::Texture(TextureFormat cpuFormat, uint32_t id)
+		: m_Id(id), m_Format(cpuFormat)
 	{
 	}
 
 	Texture::~Texture()
 	{
-		m_pResource->Release();
-		m_pSRV->Release();
+		if (m_pResource)
+		{
+			m_pResource->Release();
+		}
+
+		if (m_pSRV)
+		{
+			m_pSRV->Release();
+		}
+	}
+
+	uint32_t Texture::ReserveId()
+	{
+		return s_NextTextureId++;
 	}
 
-	Texture* Texture::LoadFromFile(ID3D11Device* device, const std::string& path)
+	Texture* Texture::LoadFromFile(ID3D11Device* device, const std::string& path, TextureFormat cpuFormat, uint32_t id)
 	{
-		auto pSurface = IMG_Load(path.c_str());
-		Texture* texture = new Texture(device, pSurface);
+		Texture* texture = new Texture(cpuFormat, id ? id : ReserveId());
+
+		// a valid cache entry skips decoding & preprocessing entirely
+		uint64_t sourceHash{};
+		std::unique_ptr<MappedFile> pEntry = TextureCache::Load(path, cpuFormat, sourceHash);
+		std::vector<uint8_t> preprocessed{};
+		const uint8_t* pData{};
+
+		if (pEntry)
+		{
+			pData = pEntry->GetData();
+		}
+		else
+		{
+			auto pSurface = IMG_Load(path.c_str());
+
+			if (!pSurface)
+			{
+				std::cout << "Failed to load " << path << "\n";
+				delete texture;
+				throw;
+			}
+
+			preprocessed = Preprocess(pSurface, cpuFormat);
+			SDL_FreeSurface(pSurface);
+
+			TextureCache::Store(sourceHash, cpuFormat, preprocessed);
+			pData = preprocessed.data();
+		}
+
+		TextureCache::Header header{};
+		std::memcpy(&header, pData, sizeof(TextureCache::Header));
+
+		texture->m_Width = header.width;
+		texture->m_Height = header.height;
+		texture->m_BlockSize = BlockCompression::GetBlockSize(cpuFormat);
+		texture->m_BlocksX = (header.width + BlockCompression::BlockDimension - 1) / BlockCompression::BlockDimension;
+
+		// the sampler reads straight from the mapped entry, or from a copy of just its part of what got built
+		if (pEntry)
+		{
+			texture->m_pCpuData = pData + header.cpuOffset;
+			texture->m_pEntry = std::move(pEntry);
+		}
+		else
+		{
+			texture->m_CpuData.assign(pData + header.cpuOffset, pData + header.cpuOffset + header.cpuSize);
+			texture->m_pCpuData = texture->m_CpuData.data();
+		}
 
 		DXGI_FORMAT format = DXGI_FORMAT_R8G8B8A8_UNORM;
 		D3D11_TEXTURE2D_DESC desc{};
-		desc.Width = pSurface->w;
-		desc.Height = pSurface->h;
-		desc.MipLevels = 1;
+		desc.Width = header.width;
+		desc.Height = header.height;
+		desc.MipLevels = header.levelCount;
 		desc.ArraySize = 1;
 		desc.Format = format;
 		desc.SampleDesc.Count = 1;
@@ -36,12 +115,19 @@ namespace dae
 		desc.CPUAccessFlags = 0;
 		desc.MiscFlags = 0;
 
-		D3D11_SUBRESOURCE_DATA initData{};
-		initData.pSysMem = pSurface->pixels;
-		initData.SysMemPitch = static_cast<UINT>(pSurface->pitch);
-		initData.SysMemSlicePitch = static_cast<UINT>(pSurface->h * pSurface->pitch);
+		D3D11_SUBRESOURCE_DATA initData[TextureCache::MaxLevels]{};
 
-		HRESULT result = device->CreateTexture2D(&desc, &initData, &texture->m_pResource);
+		for (int level = 0; level < header.levelCount; ++level)
+		{
+			const int levelWidth = std::max(1, header.width >> level);
+			const int levelHeight = std::max(1, header.height >> level);
+
+			initData[level].pSysMem = pData + header.levelOffsets[level];
+			initData[level].SysMemPitch = static_cast<UINT>(levelWidth * sizeof(uint32_t));
+			initData[level].SysMemSlicePitch = static_cast<UINT>(levelWidth * levelHeight * sizeof(uint32_t));
+		}
+
+		HRESULT result = device->CreateTexture2D(&desc, initData, &texture->m_pResource);
 
 		if (FAILED(result))
 		{
@@ -52,7 +138,7 @@ namespace dae
 		D3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc{};
 		SRVDesc.Format = format;
 		SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-		SRVDesc.Texture2D.MipLevels = 1;
+		SRVDesc.Texture2D.MipLevels = header.levelCount;
 
 		result = device->CreateShaderResourceView(texture->m_pResource, &SRVDesc, &texture->m_pSRV);
 
@@ -67,13 +153,170 @@ namespace dae
 
 	ColorRGB Texture::Sample(const Vector2& uv) const
 	{
-		int x = uv.x * m_pSurface->w;
-		int y = uv.y * m_pSurface->h;
+		const uint32_t texel = FetchTexel(uv);
+		return { (texel & 0xFF) / 255.0f, ((texel >> 8) & 0xFF) / 255.0f, ((texel >> 16) & 0xFF) / 255.0f };
+	}
+
+	ColorRGB Texture::Sample(const Vector2& uv, float& alpha) const
+	{
+		const uint32_t texel = FetchTexel(uv);
+
+		alpha = (texel >> 24) / 255.0f;
+		return { (texel & 0xFF) / 255.0f, ((texel >> 8) & 0xFF) / 255.0f, ((texel >> 16) & 0xFF) / 255.0f };
+	}
+
+	uint32_t Texture::FetchTexel(const Vector2& uv) const
+	{
+		const int x = std::clamp(static_cast<int>(uv.x * m_Width), 0, m_Width - 1);
+		const int y = std::clamp(static_cast<int>(uv.y * m_Height), 0, m_Height - 1);
+
+		if (m_Format == TextureFormat::RGBA8)
+		{
+			return reinterpret_cast<const uint32_t*>(m_pCpuData)[x + (y * m_Width)];
+		}
+
+		// only the 4 x 4 block holding the texel gets decoded, and only if this thread didn't just decode it
+		const int blockX = x / BlockCompression::BlockDimension;
+		const int blockY = y / BlockCompression::BlockDimension;
+		const uint32_t blockIndex = static_cast<uint32_t>(blockX + blockY * m_BlocksX);
+
+		DecodedBlock& block = s_DecodedBlocks[(m_Id % DecodedBlockGroups) * 16 + (blockX & 3) + ((blockY & 3) << 2)];
+
+		if (block.textureId != m_Id || block.blockIndex != blockIndex)
+		{
+			BlockCompression::DecodeBlock(m_Format, m_pCpuData + blockIndex * m_BlockSize, block.texels);
+			block.textureId = m_Id;
+			block.blockIndex = blockIndex;
+		}
+
+		return block.texels[(x & 3) + ((y & 3) << 2)];
+	}
+
+	std::vector<uint8_t> Texture::Preprocess(const SDL_Surface* pSurface, TextureFormat cpuFormat)
+	{
+		const int width = pSurface->w;
+		const int height = pSurface->h;
+
+		// everything gets unpacked to r | g << 8 | b << 16 | a << 24 first, whatever the surface's format
+		std::vector<uint32_t> texels(static_cast<size_t>(width) * height);
+
+		for (int y = 0; y < height; ++y)
+		{
+			const uint32_t* pRow = reinterpret_cast<const uint32_t*>(static_cast<const uint8_t*>(pSurface->pixels) + y * pSurface->pitch);
+
+			for (int x = 0; x < width; ++x)
+			{
+				Uint8 r, g, b, a;
+				SDL_GetRGBA(pRow[x], pSurface->format, &r, &g, &b, &a);
+				texels[x + y * width] = r | g << 8 | b << 16 | static_cast<uint32_t>(a) << 24;
+			}
+		}
+
+		// lay out the header, the mip chain & the sampler's copy, every part 16 byte aligned
+		TextureCache::Header header{};
+		header.width = width;
+		header.height = height;
+		header.cpuFormat = cpuFormat;
+
+		const auto align = [](uint64_t offset) { return (offset + 15) & ~uint64_t(15); };
+		uint64_t size = align(sizeof(TextureCache::Header));
+
+		while (header.levelCount < TextureCache::MaxLevels)
+		{
+			const int levelWidth = std::max(1, width >> header.levelCount);
+			const int levelHeight = std::max(1, height >> header.levelCount);
+
+			header.levelOffsets[header.levelCount++] = size;
+			size = align(size + static_cast<uint64_t>(levelWidth) * levelHeight * sizeof(uint32_t));
+
+			if (levelWidth == 1 && levelHeight == 1)
+			{
+				break;
+			}
+		}
+
+		const int blockSize = BlockCompression::GetBlockSize(cpuFormat);
+		const int blocksX = (width + BlockCompression::BlockDimension - 1) / BlockCompression::BlockDimension;
+		const int blocksY = (height + BlockCompression::BlockDimension - 1) / BlockCompression::BlockDimension;
+
+		header.cpuOffset = size;
+		header.cpuSize = cpuFormat == TextureFormat::RGBA8 ? texels.size() * sizeof(uint32_t) : static_cast<uint64_t>(blocksX) * blocksY * blockSize;
+
+		std::vector<uint8_t> data(header.cpuOffset + header.cpuSize);
+		std::memcpy(data.data(), &header, sizeof(TextureCache::Header));
+		std::memcpy(data.data() + header.levelOffsets[0], texels.data(), texels.size() * sizeof(uint32_t));
+
+		// box filtered, the last row & column of odd sized levels get averaged with themselves
+		for (int level = 1; level < header.levelCount; ++level)
+		{
+			const int sourceWidth = std::max(1, width >> (level - 1));
+			const int sourceHeight = std::max(1, height >> (level - 1));
+			const int levelWidth = std::max(1, width >> level);
+			const int levelHeight = std::max(1, height >> level);
+
+			const uint32_t* pSource = reinterpret_cast<const uint32_t*>(data.data() + header.levelOffsets[level - 1]);
+			uint32_t* pLevel = reinterpret_cast<uint32_t*>(data.data() + header.levelOffsets[level]);
+
+			for (int y = 0; y < levelHeight; ++y)
+			{
+				const int y0 = std::min(y * 2, sourceHeight - 1);
+				const int y1 = std::min(y * 2 + 1, sourceHeight - 1);
+
+				for (int x = 0; x < levelWidth; ++x)
+				{
+					const int x0 = std::min(x * 2, sourceWidth - 1);
+					const int x1 = std::min(x * 2 + 1, sourceWidth - 1);
+					const uint32_t quad[4]{ pSource[x0 + y0 * sourceWidth], pSource[x1 + y0 * sourceWidth], pSource[x0 + y1 * sourceWidth], pSource[x1 + y1 * sourceWidth] };
+
+					uint32_t texel{};
+
+					for (int channel = 0; channel < 4; ++channel)
+					{
+						uint32_t sum{ 2 };
+
+						for (uint32_t quadTexel : quad)
+						{
+							sum += (quadTexel >> (channel * 8)) & 0xFF;
+						}
+
+						texel |= (sum / 4) << (channel * 8);
+					}
+
+					pLevel[x + y * levelWidth] = texel;
+				}
+			}
+		}
+
+		uint8_t* pCpuData = data.data() + header.cpuOffset;
+
+		if (cpuFormat == TextureFormat::RGBA8)
+		{
+			std::memcpy(pCpuData, texels.data(), header.cpuSize);
+			return data;
+		}
+
+		JobSystem::Get().ParallelFor(blocksY, 16, [&](size_t begin, size_t end)
+		{
+			uint32_t blockTexels[BlockCompression::BlockTexels]{};
+
+			for (size_t blockY = begin; blockY < end; ++blockY)
+			{
+				for (int blockX = 0; blockX < blocksX; ++blockX)
+				{
+					// edge blocks repeat the last row & column
+					for (int i = 0; i < BlockCompression::BlockTexels; ++i)
+					{
+						const int x = std::min(blockX * BlockCompression::BlockDimension + (i & 3), width - 1);
+						const int y = std::min(static_cast<int>(blockY) * BlockCompression::BlockDimension + (i >> 2), height - 1);
+						blockTexels[i] = texels[x + y * width];
+					}
 
-		Uint8 r, g, b;
-		SDL_GetRGB(m_pSurfacePixels[x + (y * m_pSurface->w)], m_pSurface->format, &r, &g, &b);
+					BlockCompression::EncodeBlock(cpuFormat, blockTexels, pCpuData + (blockX + blockY * blocksX) * blockSize);
+				}
+			}
+		});
 
-		return { r / 255.0f, g / 255.0f, b / 255.0f };
+		return data;
 	}
 
 	ID3D11ShaderResourceView* Texture::GetSRV()
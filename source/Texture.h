@@ -2,7 +2,10 @@
 #include <SDL_surface.h>
 #include "d3dx11effect.h"
 #include <string>
+#include <vector>
 #include "ColorRGB.h"
+#include "BlockCompression.h"
+#include "TextureCache.h"
 
 namespace dae
 {
@@ -13,17 +16,38 @@ namespace dae
 	public:
 		~Texture();
 
-		static Texture* LoadFromFile(ID3D11Device* device, const std::string& path);
+		// the gpu always gets an RGBA8 mip chain, cpuFormat only decides what the software sampler reads from.
+		// both come from the texture cache when it has a valid entry, otherwise they're built & stored in it
+		// id from ReserveId, 0 reserves one here. loads running as jobs should reserve theirs before being dispatched,
+		// so every texture keeps the same group in the decoded block cache whatever order the jobs finish in
+		static Texture* LoadFromFile(ID3D11Device* device, const std::string& path, TextureFormat cpuFormat = TextureFormat::RGBA8, uint32_t id = 0);
+		static uint32_t ReserveId();
 		ColorRGB Sample(const Vector2& uv) const;
+		ColorRGB Sample(const Vector2& uv, float& alpha) const;
 		ID3D11ShaderResourceView* GetSRV();
 
 	private:
-		Texture(ID3D11Device* pDevice, SDL_Surface* pSurface);
+		Texture(TextureFormat cpuFormat, uint32_t id);
 
-		SDL_Surface* m_pSurface{ nullptr };
-		uint32_t* m_pSurfacePixels{ nullptr };
+		// tells textures apart in the per thread cache of decoded blocks & picks their group in it, 0 is never used
+		uint32_t m_Id{};
 
-		ID3D11Texture2D* m_pResource;
-		ID3D11ShaderResourceView* m_pSRV;
+		int m_Width{};
+		int m_Height{};
+		TextureFormat m_Format{};
+
+		// texels or blocks, in the mapped cache entry or in the copy
+		const uint8_t* m_pCpuData{};
+		std::unique_ptr<MappedFile> m_pEntry;
+		std::vector<uint8_t> m_CpuData;
+		int m_BlocksX{};
+		int m_BlockSize{};
+
+		ID3D11Texture2D* m_pResource{};
+		ID3D11ShaderResourceView* m_pSRV{};
+
+		// decoded source to the cache's layout: header, mip chain & the sampler's copy
+		static std::vector<uint8_t> Preprocess(const SDL_Surface* pSurface, TextureFormat cpuFormat);
+		uint32_t FetchTexel(const Vector2& uv) const;
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,298 @@
+#include "pch.h"
+#include "TextureCache.h"
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <windows.h>
+
+namespace dae
+{
+	std::unique_ptr<MappedFile> MappedFile::Open(const std::string& path)
+	{
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return nullptr;
+		}
+
+		std::unique_ptr<MappedFile> pFile{ new MappedFile() };
+		pFile->m_File = file;
+
+		LARGE_INTEGER size{};
+
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+		{
+			return nullptr;
+		}
+
+		pFile->m_Size = static_cast<size_t>(size.QuadPart);
+		pFile->m_Mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+		if (!pFile->m_Mapping)
+		{
+			return nullptr;
+		}
+
+		pFile->m_pData = static_cast<const uint8_t*>(MapViewOfFile(pFile->m_Mapping, FILE_MAP_READ, 0, 0, 0));
+
+		if (!pFile->m_pData)
+		{
+			return nullptr;
+		}
+
+		return pFile;
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (m_pData)
+		{
+			UnmapViewOfFile(m_pData);
+		}
+
+		if (m_Mapping)
+		{
+			CloseHandle(m_Mapping);
+		}
+
+		CloseHandle(m_File);
+	}
+
+	namespace TextureCache
+	{
+		namespace
+		{
+			constexpr uint32_t Magic = 'T' | 'X' << 8 | 'C' << 16 | 'H' << 24;
+			constexpr uint32_t SourceMagic = 'T' | 'X' << 8 | 'S' << 16 | 'R' << 24;
+			const std::filesystem::path Directory{ "Cache" };
+
+			// tells apart the temporary files of entries stored at the same time, two copies of one texture share an entry
+			std::atomic<uint32_t> s_NextTempId{};
+
+			// last known contents of a source file, so an unchanged one doesn't have to be hashed to find its entry
+			struct SourceRecord
+			{
+				uint32_t magic{};
+				uint32_t version{};
+				int64_t sourceTime{};
+				uint64_t sourceHash{};
+			};
+
+			uint64_t Hash(const uint8_t* pData, size_t size, uint64_t hash = 14695981039346656037ull)
+			{
+				// fnv-1a
+				for (size_t i = 0; i < size; ++i)
+				{
+					hash = (hash ^ pData[i]) * 1099511628211ull;
+				}
+
+				return hash;
+			}
+
+			// 0 if it can't be read
+			uint64_t HashFile(const std::string& path)
+			{
+				std::ifstream file(path, std::ios::binary);
+
+				if (!file)
+				{
+					return 0;
+				}
+
+				std::vector<uint8_t> chunk(1 << 16);
+				uint64_t hash = Hash(nullptr, 0);
+
+				while (file)
+				{
+					file.read(reinterpret_cast<char*>(chunk.data()), chunk.size());
+					hash = Hash(chunk.data(), static_cast<size_t>(file.gcount()), hash);
+				}
+
+				return hash;
+			}
+
+			bool GetSourceTime(const std::string& path, int64_t& time)
+			{
+				std::error_code error{};
+				const auto writeTime = std::filesystem::last_write_time(path, error);
+				time = writeTime.time_since_epoch().count();
+				return !error;
+			}
+
+			// whether [offset, offset + size) lies after the header & inside the file, without overflowing
+			bool IsInside(uint64_t offset, uint64_t size, uint64_t fileSize)
+			{
+				return offset >= sizeof(Header) && offset <= fileSize && size <= fileSize - offset;
+			}
+
+			// everything Texture reads through the header, checked against the file it came from.
+			// the header is never trusted beyond this, a corrupt entry must not index past MaxLevels or the mapping
+			bool IsConsistent(const Header& header, uint64_t fileSize)
+			{
+				if (header.width <= 0 || header.height <= 0 || header.levelCount < 1 || header.levelCount > MaxLevels)
+				{
+					return false;
+				}
+
+				for (int level = 0; level < header.levelCount; ++level)
+				{
+					const uint64_t levelWidth = std::max(1, header.width >> level);
+					const uint64_t levelHeight = std::max(1, header.height >> level);
+
+					if (!IsInside(header.levelOffsets[level], levelWidth * levelHeight * sizeof(uint32_t), fileSize))
+					{
+						return false;
+					}
+				}
+
+				// the sampler indexes texels or blocks by the size alone
+				const uint64_t blocksX = (static_cast<uint64_t>(header.width) + BlockCompression::BlockDimension - 1) / BlockCompression::BlockDimension;
+				const uint64_t blocksY = (static_cast<uint64_t>(header.height) + BlockCompression::BlockDimension - 1) / BlockCompression::BlockDimension;
+				const uint64_t cpuSize = header.cpuFormat == TextureFormat::RGBA8 ?
+					static_cast<uint64_t>(header.width) * header.height * sizeof(uint32_t) :
+					blocksX * blocksY * BlockCompression::GetBlockSize(header.cpuFormat);
+
+				return header.cpuSize == cpuSize && IsInside(header.cpuOffset, header.cpuSize, fileSize);
+			}
+
+			// entries are named after the source's contents & the format, copies of the same texture share one
+			std::filesystem::path GetEntryPath(uint64_t sourceHash, TextureFormat cpuFormat)
+			{
+				std::stringstream name{};
+				name << std::hex << sourceHash << "_" << static_cast<int>(cpuFormat) << ".tex";
+				return Directory / name.str();
+			}
+
+			// source records are named after the source's path
+			std::filesystem::path GetRecordPath(const std::string& sourcePath)
+			{
+				const uint64_t hash = Hash(reinterpret_cast<const uint8_t*>(sourcePath.data()), sourcePath.size());
+
+				std::stringstream name{};
+				name << std::hex << hash << ".src";
+				return Directory / name.str();
+			}
+
+			// written next to path & renamed over it, so a half written file never has its name.
+			// the rename fails while another instance has the old file mapped, it stays as it is
+			bool WriteFile(const std::filesystem::path& path, const void* pHeader, size_t headerSize, const void* pData, size_t dataSize)
+			{
+				std::filesystem::path tempPath = path;
+				tempPath += ".tmp" + std::to_string(s_NextTempId++);
+
+				std::error_code error{};
+				std::filesystem::create_directories(Directory, error);
+
+				{
+					std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+					file.write(static_cast<const char*>(pHeader), headerSize);
+					file.write(static_cast<const char*>(pData), dataSize);
+
+					if (!file)
+					{
+						file.close();
+						std::filesystem::remove(tempPath, error);
+						return false;
+					}
+				}
+
+				std::filesystem::rename(tempPath, path, error);
+
+				if (error)
+				{
+					std::filesystem::remove(tempPath, error);
+				}
+
+				return true;
+			}
+
+			// the source's content hash, from its record while the modification time matches, otherwise hashed & recorded.
+			// 0 if the source can't be read
+			uint64_t GetSourceHash(const std::string& sourcePath)
+			{
+				int64_t sourceTime{};
+
+				if (!GetSourceTime(sourcePath, sourceTime))
+				{
+					return 0;
+				}
+
+				const std::filesystem::path recordPath = GetRecordPath(sourcePath);
+				SourceRecord record{};
+				{
+					std::ifstream file(recordPath, std::ios::binary);
+					file.read(reinterpret_cast<char*>(&record), sizeof(SourceRecord));
+
+					if (file && record.magic == SourceMagic && record.version == Version && record.sourceTime == sourceTime)
+					{
+						return record.sourceHash;
+					}
+				}
+
+				// new, or touched but maybe not changed (a checkout, a copy): only the contents decide
+				record = { SourceMagic, Version, sourceTime, HashFile(sourcePath) };
+
+				if (record.sourceHash)
+				{
+					WriteFile(recordPath, &record, sizeof(SourceRecord), nullptr, 0);
+				}
+
+				return record.sourceHash;
+			}
+		}
+
+		std::unique_ptr<MappedFile> Load(const std::string& sourcePath, TextureFormat cpuFormat, uint64_t& sourceHash)
+		{
+			sourceHash = GetSourceHash(sourcePath);
+
+			if (!sourceHash)
+			{
+				return nullptr;
+			}
+
+			auto pFile = MappedFile::Open(GetEntryPath(sourceHash, cpuFormat).string());
+
+			// a truncated or corrupt entry (a crash while writing one) is as good as none.
+			// checks the mapped header, that's the one Texture reads. entries are never changed once written
+			if (!pFile || pFile->GetSize() < sizeof(Header))
+			{
+				return nullptr;
+			}
+
+			Header header{};
+			std::memcpy(&header, pFile->GetData(), sizeof(Header));
+
+			if (header.magic != Magic || header.version != Version || header.sourceHash != sourceHash || header.cpuFormat != cpuFormat ||
+				!IsConsistent(header, pFile->GetSize()))
+			{
+				return nullptr;
+			}
+
+			return pFile;
+		}
+
+		void Store(uint64_t sourceHash, TextureFormat cpuFormat, const std::vector<uint8_t>& data)
+		{
+			if (!sourceHash)
+			{
+				return;
+			}
+
+			Header header{};
+			std::memcpy(&header, data.data(), sizeof(Header));
+
+			header.magic = Magic;
+			header.version = Version;
+			header.sourceHash = sourceHash;
+
+			const std::filesystem::path entryPath = GetEntryPath(sourceHash, cpuFormat);
+
+			if (!WriteFile(entryPath, &header, sizeof(Header), data.data() + sizeof(Header), data.size() - sizeof(Header)))
+			{
+				std::cout << "Failed to write texture cache entry " << entryPath.string() << "\n";
+			}
+		}
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <memory>
+#include <string>
+#include "BlockCompression.h"
+
+namespace dae
+{
+	// read only view of a whole file, stays mapped until destroyed
+	class MappedFile final
+	{
+	public:
+		// nullptr if the file can't be opened or is empty
+		static std::unique_ptr<MappedFile> Open(const std::string& path);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile(MappedFile&&) noexcept = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile& operator=(MappedFile&&) noexcept = delete;
+
+		const uint8_t* GetData() const { return m_pData; };
+		size_t GetSize() const { return m_Size; };
+
+	private:
+		MappedFile() = default;
+
+		void* m_File{};
+		void* m_Mapping{};
+		const uint8_t* m_pData{};
+		size_t m_Size{};
+	};
+
+	// preprocessed textures on disk, one entry per source contents & cpu format in the Cache directory next to Resources.
+	// each source path also gets a record of its contents' hash & modification time, only a changed time makes it get hashed again
+	namespace TextureCache
+	{
+		constexpr int MaxLevels = 16;
+		// bump whenever the layout or the preprocessing changes, older entries get rebuilt
+		constexpr uint32_t Version = 2;
+
+		// start of every entry, and of textures preprocessed at load (they use the same layout).
+		// the gpu's rgba8 mip chain & the software sampler's copy follow, offsets are from the start of the header
+		struct Header
+		{
+			uint32_t magic{};
+			uint32_t version{};
+			uint64_t sourceHash{};
+
+			int32_t width{};
+			int32_t height{};
+			int32_t levelCount{};
+			TextureFormat cpuFormat{};
+
+			uint64_t levelOffsets[MaxLevels]{};
+			uint64_t cpuOffset{};
+			uint64_t cpuSize{};
+		};
+
+		// the entry of sourcePath's contents, if there is a valid one. sourceHash is for Store, 0 if the source can't be read
+		std::unique_ptr<MappedFile> Load(const std::string& sourcePath, TextureFormat cpuFormat, uint64_t& sourceHash);
+		// data starts with a Header, the source fields get filled in. failing only gets reported, the next run builds it again
+		void Store(uint64_t sourceHash, TextureFormat cpuFormat, const std::vector<uint8_t>& data);
+	}
+}
@@ -0,0 +1,54 @@
+#include "pch.h"
+#include "TileGrid.h"
+
+namespace dae
+{
+	TileGrid::TileGrid(int width, int height)
+	{
+		Resize(width, height);
+	}
+
+	void TileGrid::Resize(int width, int height)
+	{
+		m_Width = width;
+		m_Height = height;
+		m_TilesX = (width + TileSize - 1) / TileSize;
+		m_TilesY = (height + TileSize - 1) / TileSize;
+
+		m_Tiles.assign(m_TilesX * m_TilesY, Tile{});
+	}
+
+	void TileGrid::GetTileBounds(int tileX, int tileY, int& left, int& top, int& right, int& bottom) const
+	{
+		// right & bottom are exclusive, edge tiles get clipped to the buffer
+		left = tileX * TileSize;
+		top = tileY * TileSize;
+		right = std::min(left + TileSize, m_Width);
+		bottom = std::min(top + TileSize, m_Height);
+	}
+
+	void TileGrid::GetTileRange(int left, int top, int right, int bottom, int& firstX, int& firstY, int& lastX, int& lastY) const
+	{
+		// inclusive pixel rect to inclusive tile range
+		firstX = Clamp(left / TileSize, 0, m_TilesX - 1);
+		firstY = Clamp(top / TileSize, 0, m_TilesY - 1);
+		lastX = Clamp(right / TileSize, 0, m_TilesX - 1);
+		lastY = Clamp(bottom / TileSize, 0, m_TilesY - 1);
+	}
+
+	void TileGrid::BeginFrame()
+	{
+		for (Tile& tile : m_Tiles)
+		{
+			tile.touched = false;
+		}
+	}
+
+	void TileGrid::SetAllColorCleared(bool colorCleared)
+	{
+		for (Tile& tile : m_Tiles)
+		{
+			tile.colorCleared = colorCleared;
+		}
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <vector>
+
+namespace dae
+{
+	class TileGrid final
+	{
+	public:
+		static constexpr int TileSize = 32;
+
+		struct Tile
+		{
+			// touched by at least one triangle this frame
+			bool touched = false;
+			// color buffer still holds the current clear color
+			bool colorCleared = false;
+		};
+
+		TileGrid(int width, int height);
+
+		// every tile starts out untouched & uncleared again
+		void Resize(int width, int height);
+
+		int GetTilesX() const { return m_TilesX; };
+		int GetTilesY() const { return m_TilesY; };
+		int GetTileCount() const { return m_TilesX * m_TilesY; };
+
+		Tile& GetTile(int tileX, int tileY) { return m_Tiles[tileX + tileY * m_TilesX]; };
+		Tile& GetTile(int index) { return m_Tiles[index]; };
+
+		void GetTileBounds(int tileX, int tileY, int& left, int& top, int& right, int& bottom) const;
+		void GetTileRange(int left, int top, int right, int bottom, int& firstX, int& firstY, int& lastX, int& lastY) const;
+
+		void BeginFrame();
+		void SetAllColorCleared(bool colorCleared);
+
+	private:
+		int m_Width{};
+		int m_Height{};
+		int m_TilesX{};
+		int m_TilesY{};
+
+		std::vector<Tile> m_Tiles;
+	};
+}
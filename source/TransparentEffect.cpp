@@ -1,17 +1,22 @@
 #include "pch.h"
 #include "TransparentEffect.h"
+#include "SoftwareShader.h"
 
 #include <sstream>
 
-TransparentEffect::TransparentEffect(ID3D11Device* pDevice)
-	: BaseEffect(pDevice, L"Resources/Transparent3D.fx")
+TransparentEffect::TransparentEffect(ID3D11Device* pDevice, AssetFuture<Texture*> diffuseLoad)
+	: BaseEffect(pDevice, L"Resources/Transparent3D.fx", diffuseLoad)
 {
-	m_pTexture = Texture::LoadFromFile(pDevice, "Resources/fireFX_diffuse.png");
-	SetDiffuseMap(m_pTexture);
+}
+
+ShaderProgram TransparentEffect::GetSoftwareShader() const
+{
+	return ShaderProgram::TransparentEffect;
 }
 
 Texture* TransparentEffect::GetTexture()
 {
+	FinishLoading();
 	return m_pTexture;
 }
 
@@ -7,9 +7,10 @@ using namespace dae;
 class TransparentEffect : public BaseEffect
 {
 public:
-	TransparentEffect(ID3D11Device* pDevice);
+	TransparentEffect(ID3D11Device* pDevice, AssetFuture<Texture*> diffuseLoad);
 
 	Texture* GetTexture() override;
 
 	ID3D11InputLayout* CreateInputLayout(ID3D11Device* pDevice) override;
+	ShaderProgram GetSoftwareShader() const override;
 };
@@ -6,6 +6,7 @@
 
 #undef main
 #include "Renderer.h"
+#include "JobSystem.h"
 #include "main.h"
 
 using namespace dae;
@@ -18,9 +19,16 @@ void ShutDown(SDL_Window* pWindow)
 
 int main(int argc, char* args[])
 {
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
+	// --threads <n> sets the job system's thread count (main included), 1 runs everything deterministically on the main thread
+	uint32_t threadCount = 0;
+
+	for (int i = 1; i + 1 < argc; ++i)
+	{
+		if (std::string(args[i]) == "--threads")
+		{
+			threadCount = static_cast<uint32_t>(std::max(0, std::atoi(args[i + 1])));
+		}
+	}
 
 	//Create window + surfaces
 	SDL_Init(SDL_INIT_VIDEO);
@@ -38,6 +46,9 @@ int main(int argc, char* args[])
 		return 1;
 
 	//Initialize "framework"
+	const auto pJobs = new JobSystem(threadCount);
+	std::cout << "Job System: " << pJobs->GetThreadCount() << " threads\n";
+
 	const auto pTimer = new Timer();
 	const auto pRenderer = new Renderer(pWindow);
 
@@ -58,6 +69,11 @@ int main(int argc, char* args[])
 			case SDL_QUIT:
 				isLooping = false;
 				break;
+			case SDL_WINDOWEVENT:
+				// SDL doesn't repaint the window itself, an idle frame would leave it stale or blank
+				if (e.window.event == SDL_WINDOWEVENT_EXPOSED || e.window.event == SDL_WINDOWEVENT_RESTORED)
+					pRenderer->InvalidateFrame();
+				break;
 			case SDL_KEYUP:
 				if (e.key.keysym.scancode == SDL_SCANCODE_F1)
 					pRenderer->ToggleRasterizerMode();
@@ -69,6 +85,8 @@ int main(int argc, char* args[])
 					pRenderer->ToggleUniformColor();
 				else if (e.key.keysym.scancode == SDL_SCANCODE_F11)
 					shouldPrint = !shouldPrint;
+				else if (e.key.keysym.scancode == SDL_SCANCODE_H)
+					pRenderer->ToggleOcclusionCulling();
 
 				// only allow specific shortcuts if in correct render mode
 				if (pRenderer->GetRenderMode() == Renderer::RenderMode::Hardware)
@@ -88,6 +106,38 @@ int main(int argc, char* args[])
 						pRenderer->GetSoftwareRenderer()->ToggleDepthBufferVisualization();
 					else if (e.key.keysym.scancode == SDL_SCANCODE_F8)
 						pRenderer->GetSoftwareRenderer()->ToggleBoundingBoxVisualization();
+					else if (e.key.keysym.scancode == SDL_SCANCODE_1)
+						pRenderer->GetSoftwareRenderer()->CycleDepthFormat();
+					else if (e.key.keysym.scancode == SDL_SCANCODE_2)
+						pRenderer->GetSoftwareRenderer()->TogglePipelinedFrames();
+					else if (e.key.keysym.scancode == SDL_SCANCODE_3)
+						pRenderer->GetSoftwareRenderer()->ToggleAsyncOutput();
+					else if (e.key.keysym.scancode == SDL_SCANCODE_4)
+						pRenderer->GetSoftwareRenderer()->ToggleMeshletCulling();
+					else if (e.key.keysym.scancode == SDL_SCANCODE_5)
+						pRenderer->ToggleInstancing();
+					else if (e.key.keysym.scancode == SDL_SCANCODE_6)
+						pRenderer->GetSoftwareRenderer()->ToggleDynamicResolution();
+					else if (e.key.keysym.scancode == SDL_SCANCODE_7)
+						pRenderer->GetSoftwareRenderer()->CycleShadingRate();
+					else if (e.key.keysym.scancode == SDL_SCANCODE_8)
+						pRenderer->GetSoftwareRenderer()->ToggleMsaa();
+					else if (e.key.keysym.scancode == SDL_SCANCODE_9)
+						pRenderer->GetSoftwareRenderer()->ToggleDirtyTracking();
+					else if (e.key.keysym.scancode == SDL_SCANCODE_0)
+						pRenderer->GetSoftwareRenderer()->ToggleVertexTangentSpace();
+					else if (e.key.keysym.scancode == SDL_SCANCODE_P)
+						pRenderer->GetSoftwareRenderer()->ToggleFastMath();
+					else if (e.key.keysym.scancode == SDL_SCANCODE_O)
+						pRenderer->GetSoftwareRenderer()->CycleShaderProgram();
+					else if (e.key.keysym.scancode == SDL_SCANCODE_L)
+						pRenderer->ToggleLights();
+					else if (e.key.keysym.scancode == SDL_SCANCODE_K)
+						pRenderer->GetSoftwareRenderer()->CycleShadowMode();
+					else if (e.key.keysym.scancode == SDL_SCANCODE_J)
+						pRenderer->GetSoftwareRenderer()->ToggleDepthPrepass();
+					else if (e.key.keysym.scancode == SDL_SCANCODE_I)
+						pRenderer->GetSoftwareRenderer()->ToggleOverdrawCounter();
 				}
 				break;
 			default: ;
@@ -100,13 +150,26 @@ int main(int argc, char* args[])
 		//--------- Render ---------
 		pRenderer->Render();
 
+		// nothing to redraw, sleep until there's input instead of spinning (the timeout keeps held keys responsive)
+		if (pRenderer->IsIdle())
+		{
+			SDL_WaitEventTimeout(nullptr, 16);
+		}
+
 		//--------- Timer ---------
 		pTimer->Update();
 		printTimer += pTimer->GetElapsed();
 		if (printTimer >= 1.f && shouldPrint)
 		{
 			printTimer = 0.f;
-			std::cout << "dFPS: " << pTimer->GetdFPS() << std::endl;
+			std::cout << "dFPS: " << pTimer->GetdFPS() << " | Culled Meshes: " << pRenderer->GetCulledMeshCount() << "/" << pRenderer->GetMeshCount() << " | Occluded Meshes: " << pRenderer->GetOccludedMeshCount();
+
+			if (pRenderer->GetRenderMode() == Renderer::RenderMode::Software && pRenderer->GetSoftwareRenderer()->IsCountingOverdraw())
+			{
+				std::cout << " | Overdraw: " << pRenderer->GetSoftwareRenderer()->GetOverdraw();
+			}
+
+			std::cout << std::endl;
 		}
 	}
 	pTimer->Stop();
@@ -114,6 +177,7 @@ int main(int argc, char* args[])
 	//Shutdown "framework"
 	delete pRenderer;
 	delete pTimer;
+	delete pJobs;
 
 	ShutDown(pWindow);
 	return 0;